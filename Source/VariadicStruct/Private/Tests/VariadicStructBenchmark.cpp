@@ -0,0 +1,212 @@
+﻿// Copyright 2024 Ivan Baktenkov. All Rights Reserved.
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "HAL/PlatformTime.h"
+#include "Math/IntPoint.h"
+#include "Math/Quat.h"
+#include "Math/RandomStream.h"
+#include "Math/Transform.h"
+#include "Math/Vector.h"
+#include "Math/Vector2D.h"
+#include "Misc/AutomationTest.h"
+#include "VariadicStruct.h"
+#include "VariadicStructVisit.h"
+
+#if UE_VERSION_OLDER_THAN(5, 5, 0)
+#include "InstancedStruct.h"
+#else
+#include "StructUtils/InstancedStruct.h"
+#endif // UE_VERSION_OLDER_THAN
+
+/**
+ * Approximate FVariadicStruct/FInstancedStruct time ratios reported in README, the lower the better.
+ * The remaining ratios compare the current implementation with the former one, e.g. the uncached type check or the two step script ctor.
+ * Excluded from the smoke tests, should be run under Development or Shipping configuration.
+ */
+
+namespace VariadicStruct::Benchmark
+{
+	static constexpr int32 NumValues = 1 << 20;
+	static constexpr int32 NumPasses = 8;
+
+	/** Returns the best time of several passes over the values to reduce the noise. */
+	template<typename TFunc>
+	double Measure(TFunc&& Func)
+	{
+		double BestTime = TNumericLimits<double>::Max();
+
+		for (int32 Pass = 0; Pass < NumPasses; ++Pass)
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			Func();
+			BestTime = FMath::Min(BestTime, FPlatformTime::Seconds() - StartTime);
+		}
+
+		return BestTime;
+	}
+
+	/** Untyped load through GetMemory(), as done by Serialize(), Identical(), AddStructReferencedObjects(), etc. */
+	template<typename TStruct>
+	double MeasureLoad(const TArray<TStruct>& Values, const TArray<int32>& Indices)
+	{
+		volatile double Sink = 0.0;
+
+		return Measure([&]
+			{
+				double Sum = 0.0;
+
+				for (const int32 Index : Indices)
+				{
+					Sum += reinterpret_cast<const FVector*>(Values[Index].GetMemory())->X;
+				}
+
+				Sink = Sum;
+			});
+	}
+
+	/** Typed type check against the cached identity or TBaseStructure<T>::Get(), as done by GetValuePtr<T>(), IsTypeOf<T>(), etc. */
+	template<typename T>
+	double MeasureTypeCheck(const TArray<FVariadicStruct>& Values, bool bCachedIdentity)
+	{
+		volatile int32 Sink = 0;
+
+		return Measure([&]
+			{
+				int32 NumMatches = 0;
+
+				for (const FVariadicStruct& Variadic : Values)
+				{
+					NumMatches += Variadic.GetScriptStruct() == (bCachedIdentity ? GetStaticStruct<T>() : TBaseStructure<T>::Get());
+				}
+
+				Sink = NumMatches;
+			});
+	}
+
+	/** Dispatch over several candidate types by Visit() or by the chain of GetValuePtr<T>(), the values match the last candidate. */
+	double MeasureDispatch(const TArray<FVariadicStruct>& Values, bool bVisit)
+	{
+		volatile double Sink = 0.0;
+
+		return Measure([&]
+			{
+				double Sum = 0.0;
+
+				for (const FVariadicStruct& Variadic : Values)
+				{
+					if (bVisit)
+					{
+						Sum += Visit<TypePack<FIntPoint, FVector2D, FQuat, FVector>>(Variadic,
+							[](const FIntPoint& Value) { return static_cast<double>(Value.X); },
+							[](const FVector2D& Value) { return Value.X; },
+							[](const FQuat& Value) { return Value.X; },
+							[](const FVector& Value) { return Value.X; });
+					}
+					else if (const FIntPoint* const Point = Variadic.GetValuePtr<FIntPoint>())
+					{
+						Sum += Point->X;
+					}
+					else if (const FVector2D* const Vector2D = Variadic.GetValuePtr<FVector2D>())
+					{
+						Sum += Vector2D->X;
+					}
+					else if (const FQuat* const Quat = Variadic.GetValuePtr<FQuat>())
+					{
+						Sum += Quat->X;
+					}
+					else if (const FVector* const Vector = Variadic.GetValuePtr<FVector>())
+					{
+						Sum += Vector->X;
+					}
+				}
+
+				Sink = Sum;
+			});
+	}
+
+	/** Untyped construction from UScriptStruct and memory, as done by Make(FConstStructView) and the copies. */
+	template<typename T>
+	double MeasureScriptCtor(const T& Value, bool bSinglePass)
+	{
+		const UScriptStruct* const ScriptStruct = TBaseStructure<T>::Get();
+		const FTypeInfo& TypeInfo = GetTypeInfo<T>();
+		TArray<FVariadicStruct> Values;
+		Values.SetNum(NumValues / 16);
+
+		return Measure([&]
+			{
+				for (FVariadicStruct& Variadic : Values)
+				{
+					Variadic.Reset();
+
+					if (bSinglePass)
+					{
+						Variadic.InitializeAs(ScriptStruct, reinterpret_cast<const uint8*>(&Value));
+					}
+					else // The former default construction followed by the copy.
+					{
+						Variadic.InitializeAs(ScriptStruct);
+						TypeInfo.Copy(TypeInfo, Variadic.GetMutableMemory(), &Value);
+					}
+				}
+			});
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVariadicStructBenchmark, "Plugins.VariadicStruct.Benchmark", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::StressFilter);
+
+bool FVariadicStructBenchmark::RunTest(const FString&)
+{
+	using namespace VariadicStruct::Benchmark;
+
+	TArray<FVariadicStruct> VariadicValues;
+	TArray<FInstancedStruct> InstancedValues;
+	VariadicValues.Reserve(NumValues);
+	InstancedValues.Reserve(NumValues);
+
+	for (int32 Index = 0; Index < NumValues; ++Index)
+	{
+		const FVector Value(Index);
+		VariadicValues.Add(FVariadicStruct::Make(Value));
+		InstancedValues.Add(FInstancedStruct::Make(Value));
+	}
+
+	TArray<int32> SequentialIndices;
+	SequentialIndices.Reserve(NumValues);
+
+	for (int32 Index = 0; Index < NumValues; ++Index)
+	{
+		SequentialIndices.Add(Index);
+	}
+
+	TArray<int32> RandomIndices = SequentialIndices;
+	const FRandomStream RandomStream(NumValues);
+
+	for (int32 Index = NumValues - 1; Index > 0; --Index)
+	{
+		RandomIndices.Swap(Index, RandomStream.RandRange(0, Index));
+	}
+
+	const double SequentialLoad = MeasureLoad(VariadicValues, SequentialIndices) / MeasureLoad(InstancedValues, SequentialIndices);
+	const double RandomLoad = MeasureLoad(VariadicValues, RandomIndices) / MeasureLoad(InstancedValues, RandomIndices);
+
+	AddInfo(FString::Printf(TEXT("SBO load (seq/rnd): %.2f/%.2f"), SequentialLoad, RandomLoad));
+
+	const double TypeCheck = MeasureTypeCheck<FVector>(VariadicValues, true) / MeasureTypeCheck<FVector>(VariadicValues, false);
+
+	AddInfo(FString::Printf(TEXT("Cached/TBaseStructure type check: %.2f"), TypeCheck));
+
+	const double Dispatch = MeasureDispatch(VariadicValues, true) / MeasureDispatch(VariadicValues, false);
+
+	AddInfo(FString::Printf(TEXT("Visit/GetValuePtr chain dispatch: %.2f"), Dispatch));
+
+	const double VectorScriptCtor = MeasureScriptCtor(FVector(1.0), true) / MeasureScriptCtor(FVector(1.0), false);
+	const double TransformScriptCtor = MeasureScriptCtor(FTransform::Identity, true) / MeasureScriptCtor(FTransform::Identity, false);
+
+	AddInfo(FString::Printf(TEXT("Single pass/two step script ctor (SBO/HEAP): %.2f/%.2f"), VectorScriptCtor, TransformScriptCtor));
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -4,11 +4,27 @@
 
 #include "Misc/AutomationTest.h"
 #include "VariadicStruct.h"
+#include "VariadicStructBase.h"
+#include "VariadicStructOf.h"
+#include "VariadicStructPlacement.h"
+#include "VariadicStructPool.h"
+#include "VariadicStructVisit.h"
+#include "VariadicStructTestTypes.h"
 
 #include "Math/IntPoint.h"	// sizeof()  < BUFFER_SIZE
 #include "Math/Vector.h"	// sizeof() == BUFFER_SIZE
 #include "Math/Transform.h" // sizeof()  > BUFFER_SIZE
 #include "Math/Plane.h"		// Different Base Class
+#include "Math/Vector4.h"
+#include "Algo/AllOf.h"
+#include "Algo/NoneOf.h"
+#include "Misc/MemStack.h"
+#include "Templates/AlignmentTemplates.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/ObjectAndNameAsStringProxyArchive.h"
+#include "UObject/StructOnScope.h"
+#include "UObject/SoftObjectPath.h"
 
 consteval void FVariadicStructValidateTestInvariants()
 {
@@ -16,6 +32,7 @@ consteval void FVariadicStructValidateTestInvariants()
 	static_assert(sizeof(FVector) == FVariadicStruct::BUFFER_SIZE, "FVariadicStruct: Missing test case for structures == BUFFER_SIZE.");
 	static_assert(sizeof(FTransform) > FVariadicStruct::BUFFER_SIZE, "FVariadicStruct: Missing test case for structures > BUFFER_SIZE.");
 	static_assert(std::derived_from<FPlane, FVector>, "FVariadicStruct: Missing test case for accessing base class.");
+	static_assert(VariadicStruct::TIsTriviallyRelocatable<FVector>::value && VariadicStruct::TIsTriviallyRelocatable<FPlane>::value, "FVariadicStruct: Missing test case for relocating moves.");
 }
 
 /**
@@ -53,6 +70,19 @@ bool FVariadicStructTest::RunTest(const FString&)
 			UTEST_EQUAL_EXPR(Variadic.GetMutableValue<Type>(), DefaultValue);
 
 			UTEST_EQUAL_EXPR(ScriptVariadic, Variadic);
+
+			// Both paths share the native descriptor.
+			UTEST_TRUE_EXPR(Variadic.GetTypeInfo() == &VariadicStruct::GetTypeInfo<Type>());
+			UTEST_TRUE_EXPR(ScriptVariadic.GetTypeInfo() == VariadicStruct::FindOrAddTypeInfo(TBaseStructure<Type>::Get()));
+
+			// Default initialization through the fast paths matches the reflected one.
+			const UScriptStruct* const ScriptStruct = TBaseStructure<Type>::Get();
+			FStructOnScope ReflectedDefault(ScriptStruct);
+			ScriptVariadic.InitializeAs(ScriptStruct);
+			UTEST_TRUE_EXPR(ScriptStruct->CompareScriptStruct(ScriptVariadic.GetMemory(), ReflectedDefault.GetStructMemory(), PPF_None));
+			ScriptVariadic.InitializeAs(ScriptStruct);
+			UTEST_TRUE_EXPR(ScriptStruct->CompareScriptStruct(ScriptVariadic.GetMemory(), ReflectedDefault.GetStructMemory(), PPF_None));
+
 			ScriptVariadic = Variadic;
 			UTEST_EQUAL_EXPR(ScriptVariadic, Variadic);
 
@@ -80,6 +110,344 @@ bool FVariadicStructTest::RunTest(const FString&)
 	UTEST_NOT_NULL_EXPR(BaseVariadic.GetMutableValuePtr<FVector>());
 	UTEST_EQUAL_EXPR(BaseVariadic.GetValue<FVector>(), VectorTemplate);
 	UTEST_EQUAL_EXPR(BaseVariadic.GetMutableValue<FVector>(), VectorTemplate);
+	UTEST_TRUE_EXPR(BaseVariadic.IsTypeOf<FVector>() && !BaseVariadic.IsTypeOf<FIntPoint>());
+	UTEST_TRUE_EXPR(VariadicStruct::GetTypeInfo<FPlane>().Depth == VariadicStruct::GetTypeInfo<FVector>().Depth + 1);
+
+	// Zero constructible types are reset with memzero.
+	FVariadicStruct PointVariadic = FVariadicStruct::Make(PointTemplate);
+	PointVariadic.InitializeAs(TBaseStructure<FIntPoint>::Get());
+	UTEST_EQUAL_EXPR(PointVariadic.GetValue<FIntPoint>(), FIntPoint::ZeroValue);
+
+	// Default initialization copies from the snapshot built once.
+	const VariadicStruct::FTypeInfo& SnapshotTypeInfo = VariadicStruct::GetTypeInfo<FVariadicStructSnapshotTestStruct>();
+	UTEST_TRUE_EXPR(SnapshotTypeInfo.HasAnyFlags(VariadicStruct::ETypeFlags::DefaultSnapshot));
+
+	FVariadicStruct SnapshotVariadic;
+	SnapshotVariadic.InitializeAs(TBaseStructure<FVariadicStructSnapshotTestStruct>::Get());
+	const void* const Snapshot = VariadicStruct::Private::GetDefaultSnapshot(SnapshotTypeInfo);
+	UTEST_NOT_NULL_EXPR(Snapshot);
+	UTEST_TRUE_EXPR(Snapshot == VariadicStruct::Private::GetDefaultSnapshot(SnapshotTypeInfo));
+	UTEST_TRUE_EXPR(SnapshotVariadic.GetValue<FVariadicStructSnapshotTestStruct>() == FVariadicStructSnapshotTestStruct());
+
+	SnapshotVariadic.GetMutableValue<FVariadicStructSnapshotTestStruct>().Value = 0;
+	SnapshotVariadic.InitializeAs(TBaseStructure<FVariadicStructSnapshotTestStruct>::Get());
+	UTEST_TRUE_EXPR(SnapshotVariadic.GetValue<FVariadicStructSnapshotTestStruct>() == FVariadicStructSnapshotTestStruct());
+
+	// Custom layout which fits FPlane into the buffer.
+	using FLargeVariadicStruct = TVariadicStruct<40>;
+	static_assert(sizeof(FLargeVariadicStruct) == 48 && sizeof(FPlane) <= FLargeVariadicStruct::BUFFER_SIZE);
+
+	FLargeVariadicStruct LargeVariadic = FLargeVariadicStruct::Make<FPlane>(VectorTemplate);
+	UTEST_TRUE_EXPR(LargeVariadic.GetMemory() == reinterpret_cast<const uint8*>(&LargeVariadic));
+	UTEST_EQUAL_EXPR(LargeVariadic.GetValue<FVector>(), VectorTemplate);
+
+	FLargeVariadicStruct MovedLargeVariadic = MoveTemp(LargeVariadic);
+	UTEST_INVALID_EXPR(LargeVariadic);
+	UTEST_EQUAL_EXPR(MovedLargeVariadic.GetValue<FPlane>(), FPlane(VectorTemplate, 0.0));
+
+	// SBO move of a native type steals the allocations.
+	const FSoftObjectPath PathTemplate(FTopLevelAssetPath(TEXT("/Script/CoreUObject"), TEXT("Object")), TEXT("Sub.Path"));
+	static_assert(!VariadicStruct::TIsTriviallyRelocatable<FSoftObjectPath>::value);
+
+	FLargeVariadicStruct PathVariadic = FLargeVariadicStruct::Make(PathTemplate);
+	UTEST_TRUE_EXPR(PathVariadic.GetMemory() == reinterpret_cast<const uint8*>(&PathVariadic));
+	const TCHAR* const SubPathData = *PathVariadic.GetValue<FSoftObjectPath>().GetSubPathString();
+
+	FLargeVariadicStruct MovedPathVariadic = MoveTemp(PathVariadic);
+	UTEST_TRUE_EXPR(*MovedPathVariadic.GetValue<FSoftObjectPath>().GetSubPathString() == SubPathData);
+	UTEST_EQUAL_EXPR(MovedPathVariadic.GetValue<FSoftObjectPath>(), PathTemplate);
+
+	// Swap of relocatable values and the ones needing the native move.
+	FVariadicStruct SwapVariadic = FVariadicStruct::Make(TransformTemplate);
+	FVariadicStruct OtherSwapVariadic = FVariadicStruct::Make(PointTemplate);
+	Swap(SwapVariadic, OtherSwapVariadic);
+	UTEST_EQUAL_EXPR(SwapVariadic.GetValue<FIntPoint>(), PointTemplate);
+	UTEST_TRUE_EXPR(OtherSwapVariadic.GetValue<FTransform>().Equals(TransformTemplate));
+
+	MovedLargeVariadic.Swap(MovedPathVariadic);
+	UTEST_EQUAL_EXPR(MovedLargeVariadic.GetValue<FSoftObjectPath>(), PathTemplate);
+	UTEST_EQUAL_EXPR(MovedPathVariadic.GetValue<FPlane>(), FPlane(VectorTemplate, 0.0));
+
+	// The heap memory is retained for smaller types until shrunk.
+	FVariadicStruct HeapVariadic = FVariadicStruct::Make(TransformTemplate);
+	const uint8* const HeapMemory = HeapVariadic.GetMemory();
+	HeapVariadic.InitializeAs<FPlane>(VectorTemplate, 1.0);
+	UTEST_TRUE_EXPR(HeapVariadic.GetMemory() == HeapMemory);
+	HeapVariadic.Shrink();
+	UTEST_EQUAL_EXPR(HeapVariadic.GetValue<FPlane>(), FPlane(VectorTemplate, 1.0));
+
+	// FInstancedStruct heap memory is handed over without copying.
+	FInstancedStruct InstancedTransform = FInstancedStruct::Make(TransformTemplate);
+	const uint8* const InstancedMemory = InstancedTransform.GetMemory();
+
+	FVariadicStruct AdoptedVariadic = FVariadicStruct::Make(MoveTemp(InstancedTransform));
+	UTEST_INVALID_EXPR(InstancedTransform);
+	UTEST_TRUE_EXPR(AdoptedVariadic.GetValue<FTransform>().Equals(TransformTemplate));
+	UTEST_TRUE_EXPR(!FVariadicStruct::IsInstancedStructCompatible() || AdoptedVariadic.GetMemory() == InstancedMemory);
+
+	InstancedTransform = AdoptedVariadic.ReleaseToInstancedStruct();
+	UTEST_INVALID_EXPR(AdoptedVariadic);
+	UTEST_TRUE_EXPR(InstancedTransform.Get<FTransform>().Equals(TransformTemplate));
+	UTEST_TRUE_EXPR(!FVariadicStruct::IsInstancedStructCompatible() || InstancedTransform.GetMemory() == InstancedMemory);
+
+	// External memory is adopted and released without copying.
+	uint8* const ExternalMemory = static_cast<uint8*>(FMemory::Malloc(sizeof(FTransform), alignof(FTransform)));
+	new (ExternalMemory) FTransform(TransformTemplate);
+
+	FVariadicStruct ExternalVariadic;
+	ExternalVariadic.Adopt(TBaseStructure<FTransform>::Get(), ExternalMemory, [](uint8* Memory) { FMemory::Free(Memory); });
+	UTEST_TRUE_EXPR(ExternalVariadic.GetMemory() == ExternalMemory);
+	UTEST_TRUE_EXPR(ExternalVariadic.GetValue<FTransform>().Equals(TransformTemplate));
+
+	const FVariadicStruct::FReleasedStruct Released = ExternalVariadic.Release();
+	UTEST_INVALID_EXPR(ExternalVariadic);
+	UTEST_TRUE_EXPR(Released.Memory == ExternalMemory && Released.ScriptStruct == TBaseStructure<FTransform>::Get());
+	Released.ScriptStruct->DestroyStruct(Released.Memory);
+	Released.Deleter(Released.Memory);
+
+	// Bulk migration from FInstancedStruct.
+	TArray<FInstancedStruct> InstancedArray = { FInstancedStruct::Make(PointTemplate), FInstancedStruct::Make(TransformTemplate), FInstancedStruct() };
+	TArray<FVariadicStruct> VariadicArray;
+
+	const VariadicStruct::FMigrationStats MigrationStats = VariadicStruct::MoveFromInstancedStructs(InstancedArray, VariadicArray);
+	UTEST_TRUE_EXPR(InstancedArray.IsEmpty() && VariadicArray.Num() == 3);
+	UTEST_TRUE_EXPR(MigrationStats.NumInline == 1 && MigrationStats.NumHeap == 1 && MigrationStats.NumEmpty == 1);
+	UTEST_EQUAL_EXPR(VariadicArray[0].GetValue<FIntPoint>(), PointTemplate);
+	UTEST_TRUE_EXPR(VariadicArray[1].GetValue<FTransform>().Equals(TransformTemplate));
+
+	// Range operations.
+	TArray<FVariadicStruct> RangeVariadics;
+	RangeVariadics.SetNum(4);
+	RangeVariadics[1] = FVariadicStruct::Make(TransformTemplate);
+
+	FVariadicStruct::InitializeRangeAs(RangeVariadics, TBaseStructure<FIntPoint>::Get(), reinterpret_cast<const uint8*>(&PointTemplate));
+	UTEST_TRUE_EXPR(Algo::AllOf(RangeVariadics, [](const FVariadicStruct& Value) { return Value.GetValue<FIntPoint>() == PointTemplate; }));
+
+	TArray<FVariadicStruct> CopiedRangeVariadics;
+	CopiedRangeVariadics.SetNum(RangeVariadics.Num());
+	FVariadicStruct::CopyRange(CopiedRangeVariadics, RangeVariadics);
+	UTEST_TRUE_EXPR(CopiedRangeVariadics == RangeVariadics);
+
+	FVariadicStruct::ResetRange(RangeVariadics);
+	UTEST_TRUE_EXPR(Algo::NoneOf(RangeVariadics, [](const FVariadicStruct& Value) { return Value.IsValid(); }));
+
+	// Payloads placed back to back within caller provided storage.
+	{
+		alignas(16) uint8 Storage[sizeof(FTransform) * 2];
+		const int32 Offset = Align(FVariadicStructPlacement::GetRequiredSize(TBaseStructure<FIntPoint>::Get()), alignof(FTransform));
+
+		FVariadicStructPlacement PointPlacement = FVariadicStructPlacement::Emplace<FIntPoint>(Storage, PointTemplate);
+		FVariadicStructPlacement TransformPlacement = FVariadicStructPlacement::Construct(Storage + Offset, FConstStructView::Make(TransformTemplate));
+		UTEST_EQUAL_EXPR(*PointPlacement.GetValuePtr<FIntPoint>(), PointTemplate);
+		UTEST_TRUE_EXPR(TransformPlacement.GetValuePtr<FTransform>()->Equals(TransformTemplate));
+
+		PointPlacement.Destroy();
+		alignas(16) uint8 OtherStorage[sizeof(FTransform)];
+		TransformPlacement = TransformPlacement.RelocateTo(OtherStorage);
+		UTEST_TRUE_EXPR(TransformPlacement.GetMemory() == OtherStorage && TransformPlacement.GetValuePtr<FTransform>()->Equals(TransformTemplate));
+		TransformPlacement.Destroy();
+	}
+
+	// Frame allocated layout, the memory is released by FMemMark.
+	{
+		using FFrameVariadicStruct = TVariadicStruct<24, 16, void, VariadicStruct::FTypePtrHandle, VariadicStruct::FMemStackAllocator>;
+
+		FMemMark MemMark(FMemStack::Get());
+		FFrameVariadicStruct FrameVariadic = FFrameVariadicStruct::Make(TransformTemplate);
+		UTEST_TRUE_EXPR(FMemStack::Get().ContainsPointer(FrameVariadic.GetMemory()));
+		UTEST_TRUE_EXPR(FrameVariadic.GetValue<FTransform>().Equals(TransformTemplate));
+
+		FFrameVariadicStruct MovedFrameVariadic = MoveTemp(FrameVariadic);
+		UTEST_INVALID_EXPR(FrameVariadic);
+		UTEST_TRUE_EXPR(MovedFrameVariadic.GetValue<FTransform>().Equals(TransformTemplate));
+	}
+
+	// Compact layout which stores the type as a 32-bit index.
+	static_assert(sizeof(FCompactVariadicStruct) == 16 && alignof(FCompactVariadicStruct) == 8 && sizeof(FIntPoint) <= FCompactVariadicStruct::BUFFER_SIZE);
+
+	FCompactVariadicStruct CompactVariadic = FCompactVariadicStruct::Make(PointTemplate);
+	UTEST_TRUE_EXPR(CompactVariadic.GetMemory() == reinterpret_cast<const uint8*>(&CompactVariadic));
+	UTEST_TRUE_EXPR(CompactVariadic.GetTypeInfo() == &VariadicStruct::GetTypeInfo<FIntPoint>());
+	UTEST_EQUAL_EXPR(CompactVariadic.GetValue<FIntPoint>(), PointTemplate);
+
+	// Packed layout which doesn't pad the embedding structs, see README.
+	struct FPaddedParent { FVector Location; FVariadicStruct Payload; uint8 Flags; };
+	struct FPackedParent { FVector Location; FPackedVariadicStruct Payload; uint8 Flags; };
+	static_assert(sizeof(FPackedVariadicStruct) == 32 && alignof(FPackedVariadicStruct) == 8);
+	static_assert(sizeof(FPaddedParent) == 80 && sizeof(FPackedParent) == 64);
+
+	FPackedVariadicStruct PackedVariadic = FPackedVariadicStruct::Make(VectorTemplate);
+	UTEST_TRUE_EXPR(PackedVariadic.GetMemory() == reinterpret_cast<const uint8*>(&PackedVariadic));
+	static_assert(sizeof(FVector4f) <= FPackedVariadicStruct::BUFFER_SIZE && alignof(FVector4f) == 16);
+	PackedVariadic.InitializeAs<FVector4f>(1.f, 2.f, 3.f, 4.f);
+	UTEST_TRUE_EXPR(PackedVariadic.GetMemory() != reinterpret_cast<const uint8*>(&PackedVariadic));
+	UTEST_EQUAL_EXPR(PackedVariadic.GetValue<FVector4f>(), FVector4f(1.f, 2.f, 3.f, 4.f));
+
+	// Serialization compatible with the other layouts.
+	TArray<uint8> Data;
+	FMemoryWriter Writer(Data);
+	FObjectAndNameAsStringProxyArchive WriterProxy(Writer, /* bInLoadIfFindFails */ false);
+	UTEST_TRUE_EXPR(FVariadicStruct::Make(VectorTemplate).Serialize(WriterProxy));
+
+	FMemoryReader Reader(Data);
+	FObjectAndNameAsStringProxyArchive ReaderProxy(Reader, /* bInLoadIfFindFails */ true);
+	UTEST_TRUE_EXPR(CompactVariadic.Serialize(ReaderProxy));
+	UTEST_EQUAL_EXPR(CompactVariadic.GetValue<FVector>(), VectorTemplate);
+
+	// Closed set of types dispatched by the index, sized to the largest type.
+	using FClosedVariadicStruct = TVariadicStructOf<FIntPoint, FVector, FPlane>;
+	static_assert(FClosedVariadicStruct::BUFFER_SIZE == sizeof(FPlane) && FClosedVariadicStruct::IndexOf<FVector>() == 1);
+
+	FClosedVariadicStruct ClosedVariadic = FClosedVariadicStruct::Make(FPlane(VectorTemplate, 1.0));
+	UTEST_TRUE_EXPR(ClosedVariadic.IsTypeOf<FVector>() && !(ClosedVariadic.IsTypeOf<FVector, true>()));
+	UTEST_EQUAL_EXPR(ClosedVariadic.GetValue<FVector>(), VectorTemplate);
+	UTEST_TRUE_EXPR(ClosedVariadic.GetScriptStruct() == TBaseStructure<FPlane>::Get());
+
+	FClosedVariadicStruct CopiedClosedVariadic = ClosedVariadic;
+	UTEST_TRUE_EXPR(CopiedClosedVariadic == ClosedVariadic);
+	CopiedClosedVariadic.InitializeAs<FIntPoint>(PointTemplate);
+	UTEST_EQUAL_EXPR(CopiedClosedVariadic.GetTypeIndex(), 0);
+	UTEST_NULL_EXPR(CopiedClosedVariadic.GetValuePtr<FVector>());
+
+	const FClosedVariadicStruct EmptyClosedVariadic{};
+	UTEST_FALSE_EXPR((EmptyClosedVariadic.IsTypeOf<FTransform, true>()));
+	UTEST_NULL_EXPR((EmptyClosedVariadic.GetValuePtr<FTransform, true>()));
+
+	FMemoryReader ClosedReader(Data);
+	FObjectAndNameAsStringProxyArchive ClosedReaderProxy(ClosedReader, /* bInLoadIfFindFails */ true);
+	UTEST_TRUE_EXPR(ClosedVariadic.Serialize(ClosedReaderProxy));
+	UTEST_TRUE_EXPR((ClosedVariadic.IsTypeOf<FVector, true>()) && ClosedVariadic.GetValue<FVector>() == VectorTemplate);
+
+	// Values constrained to the children of the base, accessed without the type check.
+	using FVectorVariadicStruct = TVariadicStructBase<FVector>;
+
+	FVectorVariadicStruct ConstrainedVariadic = FVectorVariadicStruct::Make(FPlane(VectorTemplate, 1.0));
+	UTEST_EQUAL_EXPR(*ConstrainedVariadic.GetBase(), VectorTemplate);
+	UTEST_TRUE_EXPR(ConstrainedVariadic.GetBase() == ConstrainedVariadic.GetValuePtr<FVector>());
+	ConstrainedVariadic.Reset();
+	UTEST_NULL_EXPR(ConstrainedVariadic.GetBase());
+	UTEST_FALSE_EXPR(FVectorVariadicStruct::IsBaseOf(TBaseStructure<FIntPoint>::Get()));
+
+	FMemoryReader ConstrainedReader(Data);
+	FObjectAndNameAsStringProxyArchive ConstrainedReaderProxy(ConstrainedReader, /* bInLoadIfFindFails */ true);
+	UTEST_TRUE_EXPR(ConstrainedVariadic.Serialize(ConstrainedReaderProxy));
+	UTEST_EQUAL_EXPR(*ConstrainedVariadic.GetBase(), VectorTemplate);
+
+	// Visitation over the candidate types, the children go to the closest candidate ancestor.
+	using FVisitTypes = VariadicStruct::TypePack<FIntPoint, FVector, FTransform>;
+
+	const auto VisitIndex = [](const FVariadicStruct& Value)
+		{
+			return VariadicStruct::Visit<FVisitTypes>(Value,
+				[](const FIntPoint&) { return 0; },
+				[](const FVector&) { return 1; },
+				[](const FTransform&) { return 2; },
+				[]() { return INDEX_NONE; });
+		};
+
+	UTEST_EQUAL_EXPR(VisitIndex(FVariadicStruct::Make(PointTemplate)), 0);
+	UTEST_EQUAL_EXPR(VisitIndex(FVariadicStruct::Make(FPlane(VectorTemplate, 1.0))), 1);
+	UTEST_EQUAL_EXPR(VisitIndex(FVariadicStruct::Make(TransformTemplate)), 2);
+	UTEST_EQUAL_EXPR(VisitIndex(FVariadicStruct::Make(FVector4f())), INDEX_NONE);
+	UTEST_EQUAL_EXPR(VisitIndex(FVariadicStruct()), INDEX_NONE);
+
+	FVariadicStruct VisitedVariadic = FVariadicStruct::Make(PointTemplate);
+	VariadicStruct::Visit<FVisitTypes>(VisitedVariadic, [](FIntPoint& Value) { Value = FIntPoint::ZeroValue; }, [](auto&) {});
+	UTEST_EQUAL_EXPR(VisitedVariadic.GetValue<FIntPoint>(), FIntPoint::ZeroValue);
+
+	// Types outside of the set are skipped on load.
+	TArray<uint8> TransformData;
+	FMemoryWriter TransformWriter(TransformData);
+	FObjectAndNameAsStringProxyArchive TransformWriterProxy(TransformWriter, /* bInLoadIfFindFails */ false);
+	UTEST_TRUE_EXPR(FVariadicStruct::Make(TransformTemplate).Serialize(TransformWriterProxy));
+
+	FMemoryReader TransformReader(TransformData);
+	FObjectAndNameAsStringProxyArchive TransformReaderProxy(TransformReader, /* bInLoadIfFindFails */ true);
+	UTEST_TRUE_EXPR(ClosedVariadic.Serialize(TransformReaderProxy));
+	UTEST_INVALID_EXPR(ClosedVariadic);
+	UTEST_TRUE_EXPR(TransformReader.Tell() == TransformData.Num());
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVariadicStructPoolTest, "Plugins.VariadicStruct.Pool", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::SmokeFilter);
+
+bool FVariadicStructPoolTest::RunTest(const FString&)
+{
+	using FTestPool = VariadicStruct::Pool::Private::FTestPool;
+
+	// Class sizes are clamped to [16, 4096], rounded up to 16 bytes, deduplicated and sorted: 16, 48, 112, 4096.
+	{
+		FTestPool Pool(TEXT("100,40,48,48,9000,1"), /* InThreadCacheSize */ 4);
+		UTEST_TRUE_EXPR(Pool.GetBlockSize(1, 8) == 16);
+		UTEST_TRUE_EXPR(Pool.GetBlockSize(17, 8) == 48);
+		UTEST_TRUE_EXPR(Pool.GetBlockSize(100, 16) == 112);
+		UTEST_TRUE_EXPR(Pool.GetBlockSize(113, 16) == 4096);
+
+		// Exceeding the largest class or 16-byte alignment falls back to FMemory.
+		UTEST_TRUE_EXPR(Pool.GetBlockSize(4097, 16) == 0);
+		UTEST_TRUE_EXPR(Pool.GetBlockSize(32, 32) == 0);
+	}
+
+	// Used before the initialization, the pool stays disabled for good.
+	{
+		FTestPool Pool(TEXT("64"), /* InThreadCacheSize */ 4);
+		void* const Block = Pool.Malloc(64, 16);
+		UTEST_FALSE_EXPR(Pool.Initialize());
+		UTEST_FALSE_EXPR(Pool.IsEnabled());
+
+		Pool.Free(Block, 64, 16);
+		UTEST_EQUAL_EXPR(Pool.GetNumCached(64, /* bDepot */ false), 0);
+		UTEST_TRUE_EXPR(Pool.GetStats().NumAllocs == 0 && Pool.GetStats().NumFrees == 0);
+	}
+
+	// The excess of the thread cache and the caches of the exited threads are handed off through the depot.
+	{
+		FTestPool Pool(TEXT("64"), /* InThreadCacheSize */ 4);
+		UTEST_TRUE_EXPR(Pool.Initialize() && Pool.IsEnabled());
+
+		void* Blocks[6];
+
+		for (void*& Block : Blocks)
+		{
+			Block = Pool.Malloc(48, 16);
+			UTEST_TRUE_EXPR(IsAligned(Block, 16));
+		}
+
+		// Exceeding the cache size returns a half of the cache to the depot.
+		for (void* Block : Blocks)
+		{
+			Pool.Free(Block, 48, 16);
+		}
+
+		UTEST_EQUAL_EXPR(Pool.GetNumCached(48, /* bDepot */ false), 4);
+		UTEST_EQUAL_EXPR(Pool.GetNumCached(48, /* bDepot */ true), 2);
+
+		void* const CachedBlock = Pool.Malloc(48, 16);
+		UTEST_EQUAL_EXPR(Pool.GetNumCached(48, /* bDepot */ false), 3);
+
+		// Late frees after the thread cache is gone go straight to the depot.
+		Pool.ExitThread();
+		Pool.Free(CachedBlock, 48, 16);
+		UTEST_EQUAL_EXPR(Pool.GetNumCached(48, /* bDepot */ false), 0);
+		UTEST_EQUAL_EXPR(Pool.GetNumCached(48, /* bDepot */ true), 6);
+
+		// A new thread refills a half of its cache from the depot.
+		Pool.StartThread();
+		void* const RefilledBlock = Pool.Malloc(48, 16);
+		UTEST_EQUAL_EXPR(Pool.GetNumCached(48, /* bDepot */ false), 1);
+		UTEST_EQUAL_EXPR(Pool.GetNumCached(48, /* bDepot */ true), 4);
+		Pool.Free(RefilledBlock, 48, 16);
+
+		// Not pooled, so not counted.
+		Pool.Free(Pool.Malloc(128, 16), 128, 16);
+
+#if VARIADICSTRUCT_POOL_STATS
+		const VariadicStruct::Pool::FStats Stats = Pool.GetStats();
+		UTEST_TRUE_EXPR(Stats.NumAllocs == 8 && Stats.NumCacheHits == 1 && Stats.NumDepotHits == 1 && Stats.NumFrees == 8);
+		UTEST_EQUAL_EXPR(Stats.GetHitRate(), 0.25);
+#endif // VARIADICSTRUCT_POOL_STATS
+	}
 
 	return true;
 }
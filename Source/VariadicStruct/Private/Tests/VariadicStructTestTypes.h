@@ -0,0 +1,36 @@
+// Copyright 2024 Ivan Baktenkov. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "UObject/ObjectMacros.h"
+#include "VariadicStructTypeInfo.h"
+
+#include "VariadicStructTestTypes.generated.h"
+
+/** Plain old data with a non-zero default constructor, default initialized from the snapshot. */
+USTRUCT()
+struct FVariadicStructSnapshotTestStruct
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	int32 Value = 42;
+
+	UPROPERTY()
+	float Scale = 1.f;
+
+	bool operator==(const FVariadicStructSnapshotTestStruct& Other) const
+	{
+		return Value == Other.Value && Scale == Other.Scale;
+	}
+};
+
+template<>
+struct TIsPODType<FVariadicStructSnapshotTestStruct>
+{
+	enum { Value = true };
+};
+
+template<>
+struct VariadicStruct::TUseDefaultSnapshot<FVariadicStructSnapshotTestStruct> : std::true_type {};
@@ -2,8 +2,6 @@
 
 #include "VariadicStruct.h"
 
-#include <cstddef> // offsetof()
-
 #include "CoreGlobals.h"
 #include "Logging/LogMacros.h"
 #include "Misc/CString.h"
@@ -40,14 +38,6 @@
 
 #include UE_INLINE_GENERATED_CPP_BY_NAME(VariadicStruct)
 
-consteval void FVariadicStructValidateInvariants()
-{
-	// The following requirements needs to be met in order to avoid using std::align() to access the underlying structure memory.
-	static_assert(sizeof(FVariadicStruct::ScriptStruct) == 8 && alignof(FVariadicStruct) >= 8 && FVariadicStruct::BUFFER_SIZE >= alignof(FVariadicStruct));
-	static_assert(std::is_standard_layout_v<FVariadicStruct> && offsetof(FVariadicStruct, StructBuffer) == 0, "FVariadicStruct::StructBuffer needs to be the first member property.");
-	static_assert((FVariadicStruct::BUFFER_SIZE - sizeof(FVariadicStruct::ScriptStruct)) % alignof(FVariadicStruct) == 0, "FVariadicStruct needs to be effectively sized.");
-}
-
 namespace
 {
 	struct FVariadicStructCustomVersion
@@ -70,133 +60,25 @@ namespace
 		// Register our custom version at startup.
 		static inline const FCustomVersionRegistration Registration{ Guid, FVariadicStructCustomVersion::LatestVersion, TEXT("VariadicStructCustomVersion") };
 	};
-}
-
-FVariadicStruct::FVariadicStruct(const FVariadicStruct& InOther)
-{
-	InitializeAs(InOther.GetScriptStruct(), InOther.GetMemory());
-}
-
-FVariadicStruct::FVariadicStruct(FVariadicStruct&& InOther)
-{
-	if (InOther.ScriptStruct && !RequiresMemoryAllocation(InOther.ScriptStruct))
-	{
-		// Copy construct within the buffer, otherwise memcpy will break pointers to itself within the struct (std::list).
-		InitializeAs(InOther.ScriptStruct, InOther.GetMemory());
-
-		// Invalidate other data.
-		InOther.Reset();
-	}
-	else
-	{
-		// Take ownership.
-		ResetStructData(InOther.ScriptStruct, InOther.StructMemory);
-
-		// Reset data.
-		InOther.ResetStructData();
-	}
-}
-
-FVariadicStruct& FVariadicStruct::operator=(const FVariadicStruct& InOther)
-{
-	if (this != &InOther)
-	{
-		InitializeAs(InOther.GetScriptStruct(), InOther.GetMemory());
-	}
-
-	return *this;
-}
 
-FVariadicStruct& FVariadicStruct::operator=(FVariadicStruct&& InOther)
-{
-	if (this != &InOther)
+	/** Logs the loaded value which wasn't initialized. The types rejected by the layout, e.g. outside of the TVariadicStructOf set, are expected. */
+	void LogSkippedValue(const FArchive& Ar, const UScriptStruct* SerializedScriptStruct, int32 SerialSize)
 	{
-		if (InOther.ScriptStruct && !RequiresMemoryAllocation(InOther.ScriptStruct))
+		if (SerializedScriptStruct)
 		{
-			// Copy construct within the buffer, otherwise memcpy will break pointers to itself within the struct (std::list).
-			InitializeAs(InOther.ScriptStruct, InOther.GetMemory());
-
-			// Invalidate data.
-			InOther.Reset();
+			UE_LOG(LogSerialization, Verbose, TEXT("FVariadicStruct: Skipped %s rejected by the layout with SerialSize: %u, SerializedProperty: %s, LinkerRoot: %s."),
+				   *SerializedScriptStruct->GetName(), SerialSize, *GetPathNameSafe(Ar.GetSerializedProperty()), Ar.GetLinker() ? *GetPathNameSafe(Ar.GetLinker()->LinkerRoot) : TEXT("NoLinker"));
 		}
 		else
 		{
-			// Invalidate data and release memory.
-			Reset();
-
-			// Take ownership.
-			ResetStructData(InOther.ScriptStruct, InOther.StructMemory);
-
-			// Reset data.
-			InOther.ResetStructData();
-		}
-	}
-
-	return *this;
-}
-
-void FVariadicStruct::InitializeAs(const UScriptStruct* InScriptStruct, const uint8* InStructMemory /* = nullptr */)
-{
-	checkf(VariadicStruct::ValidateScriptStruct(InScriptStruct), TEXT("FVariadicStruct: Trying to init with unsupported UScriptStruct."));
-
-	// If the existing type is valid and matches.
-	if (IsValid() && InScriptStruct == ScriptStruct)
-	{
-		// Copy properties if needed.
-		if (InStructMemory)
-		{
-			ScriptStruct->CopyScriptStruct(GetMutableMemory(), InStructMemory);
-		}
-		else // Otherwise, reset to default state.
-		{
-			ScriptStruct->ClearScriptStruct(GetMutableMemory());
-		}
-	}
-	else
-	{
-		Reset();
-
-		// Construct a new struct if needed.
-		if ((ScriptStruct = InScriptStruct) != nullptr)
-		{
-			uint8* MemoryPtr = StructBuffer;
-
-			// Allocate a new space if the buffer is too small.
-			if (RequiresMemoryAllocation(InScriptStruct))
-			{
-				MemoryPtr = StructMemory = static_cast<uint8*>(FMemory::Malloc(InScriptStruct->GetStructureSize(), InScriptStruct->GetMinAlignment()));
-				checkSlow(MemoryPtr != nullptr);
-			}
-
-			// Default initialize.
-			ScriptStruct->InitializeStruct(MemoryPtr);
-
-			// Copy properties if needed.
-			if (InStructMemory)
-			{
-				ScriptStruct->CopyScriptStruct(MemoryPtr, InStructMemory);
-			}
-		}
-	}
-}
-
-void FVariadicStruct::Reset()
-{
-	if (uint8* const MemoryPtr = GetMutableMemory())
-	{
-		ScriptStruct->DestroyStruct(MemoryPtr);
-
-		if (RequiresMemoryAllocation(ScriptStruct))
-		{
-			FMemory::Free(MemoryPtr);
+			UE_LOG(LogSerialization, Warning, TEXT("FVariadicStruct: Failed to serialize UScriptStruct with SerialSize: %u, SerializedProperty: %s, LinkerRoot: %s."),
+				   SerialSize, *GetPathNameSafe(Ar.GetSerializedProperty()), Ar.GetLinker() ? *GetPathNameSafe(Ar.GetLinker()->LinkerRoot) : TEXT("NoLinker"));
 		}
 	}
-
-	ResetStructData();
 }
 
 // FConstStructView* is used to support nullptr as defaults.
-bool FVariadicStruct::Serialize(FArchive& Ar, const FConstStructView* StructDefaults)
+bool VariadicStruct::Private::Serialize(FVariadicRef Variadic, FArchive& Ar, const FConstStructView* StructDefaults)
 {
 	Ar.UsingCustomVersion(FVariadicStructCustomVersion::Guid);
 
@@ -219,7 +101,7 @@ bool FVariadicStruct::Serialize(FArchive& Ar, const FConstStructView* StructDefa
 			UE_LOG(LogSerialization, Log, TEXT("FVariadicStruct: DefaultScriptStruct type mismatch with SerialSize: %u, SerializedProperty: %s, LinkerRoot: %s."),
 				   SerialSize, *GetPathNameSafe(Ar.GetSerializedProperty()), Ar.GetLinker() ? *GetPathNameSafe(Ar.GetLinker()->LinkerRoot) : TEXT("NoLinker"));
 
-			InitializeAs(StructDefaults->GetScriptStruct(), StructDefaults->GetMemory());
+			Variadic.InitializeAs(StructDefaults->GetScriptStruct(), StructDefaults->GetMemory());
 			Ar.Seek(Ar.Tell() + SerialSize);
 			return true;
 		}
@@ -227,33 +109,33 @@ bool FVariadicStruct::Serialize(FArchive& Ar, const FConstStructView* StructDefa
 		const uint8* const Defaults = StructDefaults ? StructDefaults->GetMemory() : nullptr;
 
 		// Initialize only if the type is different or we have defaults.
-		if (StructDefaults || ScriptStruct != SerializedScriptStruct)
+		if (StructDefaults || Variadic.GetScriptStruct() != SerializedScriptStruct)
 		{
 			// Construct and/or copy properties from defaults.
-			InitializeAs(SerializedScriptStruct, Defaults);
+			Variadic.InitializeAs(SerializedScriptStruct, Defaults);
 		}
 
 		// Serialize the actual value.
-		if (uint8* const MemoryPtr = GetMutableMemory())
+		if (uint8* const MemoryPtr = Variadic.GetMutableMemory())
 		{
-			ConstCast(ScriptStruct)->SerializeItem(Ar, MemoryPtr, Defaults);
+			ConstCast(Variadic.GetScriptStruct())->SerializeItem(Ar, MemoryPtr, Defaults);
 		}
 		else if (SerialSize > 0)
 		{
-			UE_LOG(LogSerialization, Warning, TEXT("FVariadicStruct: Failed to serialize UScriptStruct with SerialSize: %u, SerializedProperty: %s, LinkerRoot: %s."),
-				   SerialSize, *GetPathNameSafe(Ar.GetSerializedProperty()), Ar.GetLinker() ? *GetPathNameSafe(Ar.GetLinker()->LinkerRoot) : TEXT("NoLinker"));
-
+			LogSkippedValue(Ar, SerializedScriptStruct, SerialSize);
 			Ar.Seek(Ar.Tell() + SerialSize);
 		}
 	}
 	else if (Ar.IsSaving())
 	{
 		// Reset to defaults if DefaultScriptStruct doesn't match.
-		if (StructDefaults && StructDefaults->GetScriptStruct() != ScriptStruct)
+		if (StructDefaults && StructDefaults->GetScriptStruct() != Variadic.GetScriptStruct())
 		{
-			InitializeAs(StructDefaults->GetScriptStruct(), StructDefaults->GetMemory());
+			Variadic.InitializeAs(StructDefaults->GetScriptStruct(), StructDefaults->GetMemory());
 		}
 
+		UScriptStruct* ScriptStruct = ConstCast(Variadic.GetScriptStruct());
+
 #if WITH_EDITOR
 		const UUserDefinedStruct* const UserDefinedStruct = Cast<UUserDefinedStruct>(ScriptStruct);
 		if (UserDefinedStruct && UserDefinedStruct->Status == EUserDefinedStructureStatus::UDSS_Duplicate && UserDefinedStruct->PrimaryStruct.IsValid())
@@ -277,9 +159,9 @@ bool FVariadicStruct::Serialize(FArchive& Ar, const FConstStructView* StructDefa
 		const int64 InitialOffset = Ar.Tell();
 
 		// Serialize the actual value.
-		if (uint8* const MemoryPtr = GetMutableMemory())
+		if (uint8* const MemoryPtr = Variadic.GetMutableMemory())
 		{
-			ConstCast(ScriptStruct)->SerializeItem(Ar, MemoryPtr, StructDefaults ? StructDefaults->GetMemory() : nullptr);
+			ScriptStruct->SerializeItem(Ar, MemoryPtr, StructDefaults ? StructDefaults->GetMemory() : nullptr);
 		}
 
 		// Calculate the total serialized size.
@@ -295,23 +177,33 @@ bool FVariadicStruct::Serialize(FArchive& Ar, const FConstStructView* StructDefa
 	}
 	else if (Ar.IsCountingMemory() || Ar.IsModifyingWeakAndStrongReferences() || Ar.IsObjectReferenceCollector())
 	{
+		const UScriptStruct* const ScriptStruct = Variadic.GetScriptStruct();
+
 		// Report type.
-		Ar << ScriptStruct;
+		UScriptStruct* ReportedScriptStruct = ConstCast(ScriptStruct);
+		Ar << ReportedScriptStruct;
+
+		// The type can only be replaced with a layout compatible one.
+		if (ReportedScriptStruct && ReportedScriptStruct != ScriptStruct)
+		{
+			Variadic.ReplaceScriptStruct(ReportedScriptStruct);
+		}
 
 		// Report value.
-		if (uint8* const MemoryPtr = GetMutableMemory())
+		if (uint8* const MemoryPtr = Variadic.GetMutableMemory())
 		{
-			ConstCast(ScriptStruct)->SerializeItem(Ar, MemoryPtr, /* Defaults */ nullptr);
+			ConstCast(Variadic.GetScriptStruct())->SerializeItem(Ar, MemoryPtr, /* Defaults */ nullptr);
 		}
 	}
 
 	return true;
 }
 
-bool FVariadicStruct::ExportTextItem(FString& ValueStr, const FVariadicStruct& DefaultValue, UObject* Parent, int32 PortFlags, UObject* ExportRootScope) const
+bool VariadicStruct::Private::ExportTextItem(FVariadicRef Variadic, FString& ValueStr, UObject* Parent, int32 PortFlags, UObject* ExportRootScope)
 {
-	if (const uint8* const MemoryPtr = GetMemory())
+	if (const uint8* const MemoryPtr = Variadic.GetMutableMemory())
 	{
+		const UScriptStruct* const ScriptStruct = Variadic.GetScriptStruct();
 		ValueStr += ScriptStruct->GetPathName();
 		ScriptStruct->ExportText(ValueStr, MemoryPtr, MemoryPtr, Parent, PortFlags, ExportRootScope);
 	}
@@ -323,7 +215,7 @@ bool FVariadicStruct::ExportTextItem(FString& ValueStr, const FVariadicStruct& D
 	return true;
 }
 
-bool FVariadicStruct::ImportTextItem(const TCHAR*& Buffer, int32 PortFlags, UObject* Parent, FOutputDevice* ErrorText, FArchive* InSerializingArchive /* = nullptr */)
+bool VariadicStruct::Private::ImportTextItem(FVariadicRef Variadic, const TCHAR*& Buffer, int32 PortFlags, UObject* Parent, FOutputDevice* ErrorText)
 {
 	FNameBuilder StructPathName;
 
@@ -343,7 +235,7 @@ bool FVariadicStruct::ImportTextItem(const TCHAR*& Buffer, int32 PortFlags, UObj
 
 	if (StructPathName.Len() == 0 || FCString::Stricmp(StructPathName.ToString(), TEXT("None")) == 0)
 	{
-		InitializeAs(nullptr);
+		Variadic.InitializeAs(nullptr);
 	}
 	else
 	{
@@ -363,9 +255,9 @@ bool FVariadicStruct::ImportTextItem(const TCHAR*& Buffer, int32 PortFlags, UObj
 		// This is needed for user defined structs, BP pin values, config, copy/paste, where there's no guarantee that the referenced struct has actually been loaded yet.
 		if (const UScriptStruct* const StructTypePtr = LoadObject<UScriptStruct>(nullptr, StructPathName.ToString()))
 		{
-			InitializeAs(StructTypePtr);
+			Variadic.InitializeAs(StructTypePtr);
 
-			if (const TCHAR* const Result = StructTypePtr->ImportText(Buffer, GetMutableMemory(), Parent, PortFlags, ErrorText, [StructTypePtr]() { return StructTypePtr->GetName(); }))
+			if (const TCHAR* const Result = StructTypePtr->ImportText(Buffer, Variadic.GetMutableMemory(), Parent, PortFlags, ErrorText, [StructTypePtr]() { return StructTypePtr->GetName(); }))
 			{
 				Buffer = Result;
 			}
@@ -383,10 +275,19 @@ bool FVariadicStruct::ImportTextItem(const TCHAR*& Buffer, int32 PortFlags, UObj
 	return true;
 }
 
-bool FVariadicStruct::SerializeFromMismatchedTag(const FPropertyTag& Tag, FStructuredArchive::FSlot Slot)
+bool VariadicStruct::Private::SerializeFromMismatchedTag(FVariadicRef Variadic, const FPropertyTag& Tag, FStructuredArchive::FSlot Slot)
 {
 	constexpr FGuid InstancedStructGuid{ 0xE21E1CAA, 0xAF47425E, 0x89BF6AD4, 0x4C44A8BB };
 	static const FName NAME_InstancedStruct = "InstancedStruct";
+	static const FName NAME_VariadicStruct = "VariadicStruct";
+	static const FName NAME_CompactVariadicStruct = "CompactVariadicStruct";
+	static const FName NAME_PackedVariadicStruct = "PackedVariadicStruct";
+
+	// All layouts share the same format, so the property type can be changed freely.
+	if (Tag.GetType().IsStruct(NAME_VariadicStruct) || Tag.GetType().IsStruct(NAME_CompactVariadicStruct) || Tag.GetType().IsStruct(NAME_PackedVariadicStruct))
+	{
+		return Serialize(Variadic, Slot.GetUnderlyingArchive(), /* Defaults */ nullptr);
+	}
 
 	// We should be fully serialization compatible with FInstancedStruct.
 	if (Tag.GetType().IsStruct(NAME_InstancedStruct))
@@ -431,28 +332,26 @@ bool FVariadicStruct::SerializeFromMismatchedTag(const FPropertyTag& Tag, FStruc
 			}
 
 			// Initialize only if the type changes.
-			if (ScriptStruct != SerializedScriptStruct)
+			if (Variadic.GetScriptStruct() != SerializedScriptStruct)
 			{
-				InitializeAs(SerializedScriptStruct);
+				Variadic.InitializeAs(SerializedScriptStruct);
 			}
 
 			int32 SerialSize = 0;
 			Ar << SerialSize;
 
 			// Check if the type is not missed.
-			if (!ScriptStruct && SerialSize > 0)
+			if (!Variadic.GetScriptStruct() && SerialSize > 0)
 			{
 				// Step over missing data.
 				Ar.Seek(Ar.Tell() + SerialSize);
-
-				UE_LOG(LogSerialization, Warning, TEXT("FVariadicStruct: Failed to serialize UScriptStruct with SerialSize: %u, SerializedProperty: %s, LinkerRoot: %s."),
-					   SerialSize, *GetPathNameSafe(Ar.GetSerializedProperty()), Ar.GetLinker() ? *GetPathNameSafe(Ar.GetLinker()->LinkerRoot) : TEXT("NoLinker"));
+				LogSkippedValue(Ar, SerializedScriptStruct, SerialSize);
 			}
 
 			// Serialize the actual value.
-			if (uint8* const MemoryPtr = GetMutableMemory())
+			if (uint8* const MemoryPtr = Variadic.GetMutableMemory())
 			{
-				ConstCast(ScriptStruct)->SerializeItem(Ar, MemoryPtr, /* Defaults */ nullptr);
+				ConstCast(Variadic.GetScriptStruct())->SerializeItem(Ar, MemoryPtr, /* Defaults */ nullptr);
 			}
 		}
 
@@ -462,10 +361,11 @@ bool FVariadicStruct::SerializeFromMismatchedTag(const FPropertyTag& Tag, FStruc
 	return false;
 }
 
-void FVariadicStruct::GetPreloadDependencies(TArray<UObject*>& OutDeps)
+void VariadicStruct::Private::GetPreloadDependencies(FVariadicRef Variadic, TArray<UObject*>& OutDeps)
 {
-	if (uint8* const MemoryPtr = GetMutableMemory())
+	if (uint8* const MemoryPtr = Variadic.GetMutableMemory())
 	{
+		const UScriptStruct* const ScriptStruct = Variadic.GetScriptStruct();
 		OutDeps.Add(ConstCast(ScriptStruct));
 
 		// Report direct dependencies.
@@ -488,17 +388,7 @@ void FVariadicStruct::GetPreloadDependencies(TArray<UObject*>& OutDeps)
 	}
 }
 
-bool FVariadicStruct::Identical(const FVariadicStruct* Other, uint32 PortFlags) const
-{
-	if (ScriptStruct && ScriptStruct == Other->ScriptStruct)
-	{
-		return ScriptStruct->CompareScriptStruct(GetMemory(), Other->GetMemory(), PortFlags);
-	}
-
-	return false;
-}
-
-void FVariadicStruct::AddStructReferencedObjects(FReferenceCollector& Collector)
+void VariadicStruct::Private::AddStructReferencedObjects(FVariadicRef Variadic, FReferenceCollector& Collector)
 {
 #if WITH_EDITOR
 	// Reference collector is used to visit all instances of instanced structs and replace their contents.	
@@ -508,7 +398,7 @@ void FVariadicStruct::AddStructReferencedObjects(FReferenceCollector& Collector)
 	if (const UUserDefinedStruct* StructureToReinstance = UE::StructUtils::Private::GetStructureToReinstantiate())
 #endif // UE_VERSION_OLDER_THAN
 	{
-		if (const UUserDefinedStruct* UserDefinedStruct = Cast<UUserDefinedStruct>(ScriptStruct))
+		if (const UUserDefinedStruct* UserDefinedStruct = Cast<UUserDefinedStruct>(Variadic.GetScriptStruct()))
 		{
 			if (StructureToReinstance->Status == EUserDefinedStructureStatus::UDSS_Duplicate)
 			{
@@ -517,7 +407,7 @@ void FVariadicStruct::AddStructReferencedObjects(FReferenceCollector& Collector)
 
 				if (UserDefinedStruct == StructureToReinstance->PrimaryStruct)
 				{
-					ScriptStruct = StructureToReinstance;
+					Variadic.ReplaceScriptStruct(StructureToReinstance);
 				}
 			}
 			else
@@ -544,32 +434,47 @@ void FVariadicStruct::AddStructReferencedObjects(FReferenceCollector& Collector)
 
 					FMemoryWriter Writer(Data);
 					FObjectAndNameAsStringProxyArchive WriterProxy(Writer, /* bInLoadIfFindFails */ true);
-					Serialize(WriterProxy);
+					Serialize(Variadic, WriterProxy, /* Defaults */ nullptr);
 
 					FMemoryReader Reader(Data);
 					FObjectAndNameAsStringProxyArchive ReaderProxy(Reader, /* bInLoadIfFindFails */ true);
-					Serialize(ReaderProxy);
+					Serialize(Variadic, ReaderProxy, /* Defaults */ nullptr);
 				}
 			}
 		}
 	}
 #endif // WITH_EDITOR
 
-	if (uint8* const MemoryPtr = GetMutableMemory())
+	if (uint8* const MemoryPtr = Variadic.GetMutableMemory())
 	{
+		const UScriptStruct* const StoredScriptStruct = Variadic.GetScriptStruct();
+		TObjectPtr<const UScriptStruct> ScriptStruct = StoredScriptStruct;
 		Collector.AddReferencedObject(ScriptStruct);
+
+		// The collector might null out the garbage types or replace the reinstanced ones, which needs to be reflected in the stored type.
+		if (ScriptStruct != StoredScriptStruct)
+		{
+			if (!ScriptStruct)
+			{
+				Variadic.InitializeAs(nullptr, nullptr);
+				return;
+			}
+
+			Variadic.ReplaceScriptStruct(ScriptStruct);
+		}
+
 		Collector.AddPropertyReferencesWithStructARO(ScriptStruct, MemoryPtr);
 	}
 }
 
-bool FVariadicStruct::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+bool VariadicStruct::Private::NetSerialize(FVariadicRef Variadic, FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
 {
 #if WITH_ENGINE
 	uint8 bIsValid = 0;
 
 	if (Ar.IsSaving())
 	{
-		bIsValid = IsValid();
+		bIsValid = Variadic.GetScriptStruct() != nullptr;
 	}
 
 	Ar.SerializeBits(&bIsValid, 1);
@@ -579,7 +484,7 @@ bool FVariadicStruct::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuc
 		// Reset the existing struct.
 		if (Ar.IsLoading())
 		{
-			Reset();
+			Variadic.InitializeAs(nullptr);
 		}
 	}
 	else
@@ -587,6 +492,7 @@ bool FVariadicStruct::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuc
 		// Serialize UScripStruct.
 		if (Ar.IsSaving())
 		{
+			UScriptStruct* ScriptStruct = ConstCast(Variadic.GetScriptStruct());
 			Ar << ScriptStruct;
 		}
 		else if (Ar.IsLoading())
@@ -595,12 +501,12 @@ bool FVariadicStruct::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuc
 			Ar << SerializedScriptStruct;
 
 			// Initialize only if the type changes.
-			if (ScriptStruct != SerializedScriptStruct)
+			if (Variadic.GetScriptStruct() != SerializedScriptStruct)
 			{
-				InitializeAs(SerializedScriptStruct);
+				Variadic.InitializeAs(SerializedScriptStruct);
 			}
 
-			if (ScriptStruct == nullptr)
+			if (Variadic.GetScriptStruct() == nullptr)
 			{
 				UE_LOG(LogNetSerialization, Error, TEXT("FVariadicStruct: Failed to NetSerialize UScriptStruct and recover the corrupted archive."));
 				bOutSuccess = false;
@@ -609,8 +515,10 @@ bool FVariadicStruct::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuc
 		}
 
 		// Serialize the actual value.
-		if (uint8* const MemoryPtr = GetMutableMemory())
+		if (uint8* const MemoryPtr = Variadic.GetMutableMemory())
 		{
+			UScriptStruct* const ScriptStruct = ConstCast(Variadic.GetScriptStruct());
+
 			if (ScriptStruct->StructFlags & STRUCT_NetSerializeNative)
 			{
 				ScriptStruct->GetCppStructOps()->NetSerialize(Ar, Map, bOutSuccess, MemoryPtr);
@@ -622,8 +530,8 @@ bool FVariadicStruct::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuc
 				if (ensureAlways(::IsValid(NetConnection) && ::IsValid(NetConnection->GetDriver())))
 				{
 					bool bHasUnmapped = false;
-					const TSharedRef<FRepLayout> RepLayout = NetConnection->GetDriver()->GetStructRepLayout(ConstCast(ScriptStruct)).ToSharedRef();
-					RepLayout->SerializePropertiesForStruct(ConstCast(ScriptStruct), static_cast<FBitArchive&>(Ar), Map, MemoryPtr, bHasUnmapped);
+					const TSharedRef<FRepLayout> RepLayout = NetConnection->GetDriver()->GetStructRepLayout(ScriptStruct).ToSharedRef();
+					RepLayout->SerializePropertiesForStruct(ScriptStruct, static_cast<FBitArchive&>(Ar), Map, MemoryPtr, bHasUnmapped);
 				}
 			}
 		}
@@ -638,11 +546,11 @@ bool FVariadicStruct::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuc
 #endif // WITH_ENGINE
 }
 
-bool FVariadicStruct::FindInnerPropertyInstance(FName PropertyName, const FProperty*& OutProp, const void*& OutData) const
+bool VariadicStruct::Private::FindInnerPropertyInstance(FVariadicRef Variadic, FName PropertyName, const FProperty*& OutProp, const void*& OutData)
 {
-	if (const uint8* const MemoryPtr = GetMemory())
+	if (const uint8* const MemoryPtr = Variadic.GetMutableMemory())
 	{
-		for (const FProperty* const Prop : TFieldRange<FProperty>(ScriptStruct))
+		for (const FProperty* const Prop : TFieldRange<FProperty>(Variadic.GetScriptStruct()))
 		{
 			if (Prop->GetFName() == PropertyName)
 			{
@@ -658,21 +566,21 @@ bool FVariadicStruct::FindInnerPropertyInstance(FName PropertyName, const FPrope
 
 #if !UE_VERSION_OLDER_THAN(5, 5, 0)
 
-EPropertyVisitorControlFlow FVariadicStruct::Visit(FPropertyVisitorPath& Path, const FPropertyVisitorData& InData, const TFunctionRef<EPropertyVisitorControlFlow(const FPropertyVisitorPath& /*Path*/, const FPropertyVisitorData& /*Data*/)> InFunc) const
+EPropertyVisitorControlFlow VariadicStruct::Private::Visit(FVariadicRef Variadic, FPropertyVisitorPath& Path, const FPropertyVisitorData& InData, const TFunctionRef<EPropertyVisitorControlFlow(const FPropertyVisitorPath& /*Path*/, const FPropertyVisitorData& /*Data*/)> InFunc)
 {
-	if (uint8* const MemoryPtr = const_cast<uint8*>(GetMemory()))
+	if (uint8* const MemoryPtr = Variadic.GetMutableMemory())
 	{
-		return ScriptStruct->Visit(Path, InData.VisitPropertyData(MemoryPtr), InFunc);
+		return Variadic.GetScriptStruct()->Visit(Path, InData.VisitPropertyData(MemoryPtr), InFunc);
 	}
 
 	return EPropertyVisitorControlFlow::StepOver;
 }
 
-void* FVariadicStruct::ResolveVisitedPathInfo(const FPropertyVisitorInfo& Info) const
+void* VariadicStruct::Private::ResolveVisitedPathInfo(FVariadicRef Variadic, const FPropertyVisitorInfo& Info)
 {
-	if (uint8* const MemoryPtr = const_cast<uint8*>(GetMemory()))
+	if (uint8* const MemoryPtr = Variadic.GetMutableMemory())
 	{
-		return ScriptStruct->ResolveVisitedPathInfo(MemoryPtr, Info);
+		return Variadic.GetScriptStruct()->ResolveVisitedPathInfo(MemoryPtr, Info);
 	}
 
 	return nullptr;
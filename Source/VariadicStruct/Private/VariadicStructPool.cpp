@@ -0,0 +1,512 @@
+// Copyright 2024 Ivan Baktenkov. All Rights Reserved.
+
+#include "VariadicStructPool.h"
+
+#include "Containers/Array.h"
+#include "Containers/UnrealString.h"
+#include "HAL/CriticalSection.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/UnrealMemory.h"
+#include "Logging/LogMacros.h"
+#include "Math/UnrealMathUtility.h"
+#include "Misc/CString.h"
+#include "Misc/ScopeLock.h"
+
+#include <atomic>
+
+DEFINE_LOG_CATEGORY_STATIC(LogVariadicStructPool, Log, All);
+
+namespace
+{
+	bool GPoolEnabled = false;
+	FAutoConsoleVariableRef CVarPoolEnabled(
+		TEXT("VariadicStruct.Pool.Enabled"),
+		GPoolEnabled,
+		TEXT("Whether the payloads exceeding the inline buffer are allocated from the size-class pool. Latched on the module startup."),
+		ECVF_ReadOnly);
+
+	FString GPoolSizeClasses = TEXT("32,48,64,96,128,192,256,384,512");
+	FAutoConsoleVariableRef CVarPoolSizeClasses(
+		TEXT("VariadicStruct.Pool.SizeClasses"),
+		GPoolSizeClasses,
+		TEXT("Comma separated block sizes of the pool, rounded up to 16 bytes. Latched on the module startup."),
+		ECVF_ReadOnly);
+
+	int32 GPoolThreadCacheSize = 64;
+	FAutoConsoleVariableRef CVarPoolThreadCacheSize(
+		TEXT("VariadicStruct.Pool.ThreadCacheSize"),
+		GPoolThreadCacheSize,
+		TEXT("Max number of cached blocks per size class per thread, the excess is returned to the shared depot. Latched on the module startup."),
+		ECVF_ReadOnly);
+
+	/** Alignment of all blocks, greater alignments aren't pooled. */
+	constexpr uint32 BlockAlignment = 16;
+
+	/** Upper bounds of the configuration. */
+	constexpr int32 MaxNumClasses = 16;
+	constexpr uint32 MaxClassSize = 4096;
+
+	/** Intrusive free list node stored in the freed block itself. */
+	struct FBlock
+	{
+		FBlock* Next;
+	};
+
+	/** Singly linked list of the free blocks of one size class. */
+	struct FBlockList
+	{
+		FBlock* Head = nullptr;
+		int32 Num = 0;
+
+		void Push(void* Ptr)
+		{
+			FBlock* const Block = static_cast<FBlock*>(Ptr);
+			Block->Next = Head;
+			Head = Block;
+			++Num;
+		}
+
+		void* Pop()
+		{
+			FBlock* const Block = Head;
+			Head = Block->Next;
+			--Num;
+			return Block;
+		}
+
+		/** Moves up to Count blocks into another list. */
+		void MoveTo(FBlockList& Other, int32 Count)
+		{
+			for (; Count > 0 && Head; --Count)
+			{
+				Other.Push(Pop());
+			}
+		}
+	};
+
+	/** Configuration latched by Pool::Initialize() on the module startup, after the ini values are applied. */
+	struct FPoolConfig
+	{
+		bool bEnabled = false;
+		int32 ThreadCacheSize = 0;
+		int32 NumClasses = 0;
+		uint32 ClassSizes[MaxNumClasses] = {};
+
+		/** Size class by Size / BlockAlignment, INDEX_NONE if not pooled. */
+		int8 ClassBySize[MaxClassSize / BlockAlignment + 1] = {};
+
+		/** Builds the configuration from the console variables. */
+		static const FPoolConfig* MakeFromConsoleVariables()
+		{
+			return new FPoolConfig(GPoolEnabled, GPoolSizeClasses, GPoolThreadCacheSize);
+		}
+
+		/** Returns the disabled configuration, latched if the pool is used before the initialization. */
+		static const FPoolConfig& GetDisabled()
+		{
+			static const FPoolConfig Disabled(/* bInEnabled */ false, FString(), /* InThreadCacheSize */ 0);
+			return Disabled;
+		}
+
+		/** Returns the latched configuration, or latches the disabled one if used before the initialization. */
+		static const FPoolConfig& Get(std::atomic<const FPoolConfig*>& Latched)
+		{
+			if (const FPoolConfig* const Config = Latched.load(std::memory_order_acquire); LIKELY(Config))
+			{
+				return *Config;
+			}
+
+			// The blocks allocated from FMemory can't be returned to the pool later, so it stays disabled for good.
+			const FPoolConfig* Config = nullptr;
+			return Latched.compare_exchange_strong(Config, &GetDisabled(), std::memory_order_acq_rel, std::memory_order_acquire) ? GetDisabled() : *Config;
+		}
+
+		/** Latches the configuration unless the pool was already used. Returns false if the configuration wasn't latched. */
+		static bool Latch(std::atomic<const FPoolConfig*>& Latched, const FPoolConfig* InConfig)
+		{
+			const FPoolConfig* Config = nullptr;
+			return Latched.compare_exchange_strong(Config, InConfig, std::memory_order_acq_rel, std::memory_order_acquire);
+		}
+
+		FPoolConfig(bool bInEnabled, const FString& InSizeClasses, int32 InThreadCacheSize)
+		{
+			bEnabled = bInEnabled;
+			ThreadCacheSize = FMath::Max(InThreadCacheSize, 1);
+
+			TArray<FString> Sizes;
+			InSizeClasses.ParseIntoArray(Sizes, TEXT(","));
+
+			TArray<uint32> SortedSizes;
+
+			for (const FString& Size : Sizes)
+			{
+				const uint32 ClassSize = Align(static_cast<uint32>(FMath::Clamp(FCString::Atoi(*Size), int32(BlockAlignment), int32(MaxClassSize))), BlockAlignment);
+				SortedSizes.AddUnique(ClassSize);
+			}
+
+			SortedSizes.Sort();
+			NumClasses = FMath::Min(SortedSizes.Num(), MaxNumClasses);
+
+			for (int32 Class = 0; Class < NumClasses; ++Class)
+			{
+				ClassSizes[Class] = SortedSizes[Class];
+			}
+
+			// Map each size to the smallest class fitting it.
+			for (int32 Index = 0, Class = 0; Index < UE_ARRAY_COUNT(ClassBySize); ++Index)
+			{
+				while (Class < NumClasses && ClassSizes[Class] < Index * BlockAlignment)
+				{
+					++Class;
+				}
+
+				ClassBySize[Index] = Class < NumClasses ? static_cast<int8>(Class) : INDEX_NONE;
+			}
+		}
+
+		int32 FindClass(SIZE_T Size, uint32 Alignment) const
+		{
+			return Size <= MaxClassSize && Alignment <= BlockAlignment ? ClassBySize[(Size + BlockAlignment - 1) / BlockAlignment] : INDEX_NONE;
+		}
+	};
+
+	/** Latched configuration, nullptr until Pool::Initialize() or the first use. */
+	std::atomic<const FPoolConfig*> GPoolConfig = nullptr;
+
+	struct FPoolCounters
+	{
+		std::atomic<uint64> NumAllocs = 0;
+		std::atomic<uint64> NumCacheHits = 0;
+		std::atomic<uint64> NumDepotHits = 0;
+		std::atomic<uint64> NumFrees = 0;
+
+		VariadicStruct::Pool::FStats GetStats() const
+		{
+			VariadicStruct::Pool::FStats Stats;
+
+#if VARIADICSTRUCT_POOL_STATS
+			Stats.NumAllocs = NumAllocs.load(std::memory_order_relaxed);
+			Stats.NumCacheHits = NumCacheHits.load(std::memory_order_relaxed);
+			Stats.NumDepotHits = NumDepotHits.load(std::memory_order_relaxed);
+			Stats.NumFrees = NumFrees.load(std::memory_order_relaxed);
+#endif // VARIADICSTRUCT_POOL_STATS
+
+			return Stats;
+		}
+	};
+
+#if VARIADICSTRUCT_POOL_STATS
+#define VARIADICSTRUCT_POOL_INC(Counters, Counter) (Counters).Counter.fetch_add(1, std::memory_order_relaxed)
+#else
+#define VARIADICSTRUCT_POOL_INC(Counters, Counter)
+#endif // VARIADICSTRUCT_POOL_STATS
+
+	/**
+	 * Shared storage for the blocks exceeding the thread caches and the ones left by the exited threads.
+	 * The global one is leaked on purpose, as the thread caches of the late exiting threads might still return the blocks during the static destruction.
+	 */
+	class FPoolDepot
+	{
+	public:
+
+		static FPoolDepot& Get()
+		{
+			static FPoolDepot& Depot = *new FPoolDepot();
+			return Depot;
+		}
+
+		void Push(int32 Class, FBlockList& Blocks, int32 Count)
+		{
+			FScopeLock ScopeLock(&Locks[Class]);
+			Blocks.MoveTo(Bins[Class], Count);
+		}
+
+		void Pop(int32 Class, FBlockList& Blocks, int32 Count)
+		{
+			FScopeLock ScopeLock(&Locks[Class]);
+			Bins[Class].MoveTo(Blocks, Count);
+		}
+
+		void PushBlock(int32 Class, void* Ptr)
+		{
+			FScopeLock ScopeLock(&Locks[Class]);
+			Bins[Class].Push(Ptr);
+		}
+
+		void* PopBlock(int32 Class)
+		{
+			FScopeLock ScopeLock(&Locks[Class]);
+			return Bins[Class].Head ? Bins[Class].Pop() : nullptr;
+		}
+
+		int32 Num(int32 Class)
+		{
+			FScopeLock ScopeLock(&Locks[Class]);
+			return Bins[Class].Num;
+		}
+
+		/** Frees all blocks, only for the depots which outlive all of their threads. */
+		void FreeAll()
+		{
+			for (FBlockList& Blocks : Bins)
+			{
+				while (Blocks.Head)
+				{
+					FMemory::Free(Blocks.Pop());
+				}
+			}
+		}
+
+	private:
+
+		FCriticalSection Locks[MaxNumClasses];
+		FBlockList Bins[MaxNumClasses];
+	};
+
+	/** Per thread free lists. */
+	struct FThreadCache
+	{
+		FBlockList Bins[MaxNumClasses];
+
+		/** Returns all cached blocks to the depot. */
+		void Flush(FPoolDepot& Depot)
+		{
+			for (int32 Class = 0; Class < MaxNumClasses; ++Class)
+			{
+				if (Bins[Class].Num > 0)
+				{
+					Depot.Push(Class, Bins[Class], Bins[Class].Num);
+				}
+			}
+		}
+	};
+
+	/** Everything the allocation needs, the global pool or an isolated one of the tests. */
+	struct FPoolContext
+	{
+		const FPoolConfig& Config;
+		FPoolDepot& Depot;
+
+		/** Thread cache of the caller, nullptr once destroyed, so the blocks go straight to the depot. */
+		FThreadCache* Cache;
+
+		FPoolCounters& Counters;
+	};
+
+	void* PoolMalloc(const FPoolContext& Context, SIZE_T Size, uint32 Alignment)
+	{
+		const FPoolConfig& Config = Context.Config;
+
+		if (const int32 Class = Config.bEnabled ? Config.FindClass(Size, Alignment) : INDEX_NONE; Class != INDEX_NONE)
+		{
+			VARIADICSTRUCT_POOL_INC(Context.Counters, NumAllocs);
+
+			if (Context.Cache)
+			{
+				FBlockList& Blocks = Context.Cache->Bins[Class];
+
+				if (Blocks.Head)
+				{
+					VARIADICSTRUCT_POOL_INC(Context.Counters, NumCacheHits);
+					return Blocks.Pop();
+				}
+
+				// Refill a half of the cache to amortize the lock.
+				Context.Depot.Pop(Class, Blocks, FMath::Max(Config.ThreadCacheSize / 2, 1));
+
+				if (Blocks.Head)
+				{
+					VARIADICSTRUCT_POOL_INC(Context.Counters, NumDepotHits);
+					return Blocks.Pop();
+				}
+			}
+			else if (void* const Block = Context.Depot.PopBlock(Class))
+			{
+				VARIADICSTRUCT_POOL_INC(Context.Counters, NumDepotHits);
+				return Block;
+			}
+
+			return FMemory::Malloc(Config.ClassSizes[Class], BlockAlignment);
+		}
+
+		return FMemory::Malloc(Size, Alignment);
+	}
+
+	void PoolFree(const FPoolContext& Context, void* Ptr, SIZE_T Size, uint32 Alignment)
+	{
+		const FPoolConfig& Config = Context.Config;
+
+		if (const int32 Class = Config.bEnabled && Ptr ? Config.FindClass(Size, Alignment) : INDEX_NONE; Class != INDEX_NONE)
+		{
+			VARIADICSTRUCT_POOL_INC(Context.Counters, NumFrees);
+
+			// Freed after the thread cache, e.g. by the destructors of other thread_local objects.
+			if (!Context.Cache)
+			{
+				Context.Depot.PushBlock(Class, Ptr);
+				return;
+			}
+
+			FBlockList& Blocks = Context.Cache->Bins[Class];
+			Blocks.Push(Ptr);
+
+			// Return a half of the cache, so other threads can reuse the blocks.
+			if (Blocks.Num > Config.ThreadCacheSize)
+			{
+				Context.Depot.Push(Class, Blocks, Blocks.Num / 2);
+			}
+
+			return;
+		}
+
+		FMemory::Free(Ptr);
+	}
+
+	FPoolCounters GPoolCounters;
+
+	/** Set once the thread cache of the thread is destroyed. Trivially destructible, so it stays readable by the later thread_local destructors. */
+	thread_local bool GThreadCacheDestroyed = false;
+
+	/** Thread cache of the global pool, returned to the global depot when the thread exits. */
+	struct FGlobalThreadCache : FThreadCache
+	{
+		~FGlobalThreadCache()
+		{
+			GThreadCacheDestroyed = true;
+			Flush(FPoolDepot::Get());
+		}
+	};
+
+	thread_local FGlobalThreadCache GThreadCache;
+
+	FPoolContext GetGlobalContext()
+	{
+		return FPoolContext{ FPoolConfig::Get(GPoolConfig), FPoolDepot::Get(), GThreadCacheDestroyed ? nullptr : &GThreadCache, GPoolCounters };
+	}
+}
+
+void VariadicStruct::Pool::Initialize()
+{
+	const FPoolConfig* const Config = FPoolConfig::MakeFromConsoleVariables();
+
+	if (FPoolConfig::Latch(GPoolConfig, Config))
+	{
+		UE_CLOG(Config->bEnabled, LogVariadicStructPool, Log, TEXT("Enabled with %d size classes up to %u bytes."), Config->NumClasses, Config->NumClasses ? Config->ClassSizes[Config->NumClasses - 1] : 0);
+	}
+	else
+	{
+		UE_CLOG(Config->bEnabled && !IsEnabled(), LogVariadicStructPool, Warning, TEXT("Stays disabled, as it was used before the module startup."));
+		delete Config;
+	}
+}
+
+bool VariadicStruct::Pool::IsEnabled()
+{
+	return FPoolConfig::Get(GPoolConfig).bEnabled;
+}
+
+void* VariadicStruct::Pool::Malloc(SIZE_T Size, uint32 Alignment)
+{
+	return PoolMalloc(GetGlobalContext(), Size, Alignment);
+}
+
+void VariadicStruct::Pool::Free(void* Ptr, SIZE_T Size, uint32 Alignment)
+{
+	PoolFree(GetGlobalContext(), Ptr, Size, Alignment);
+}
+
+VariadicStruct::Pool::FStats VariadicStruct::Pool::GetStats()
+{
+	return GPoolCounters.GetStats();
+}
+
+#if WITH_DEV_AUTOMATION_TESTS
+struct VariadicStruct::Pool::Private::FTestPool::FImpl
+{
+	FPoolConfig Config;
+	std::atomic<const FPoolConfig*> Latched = nullptr;
+	FPoolDepot Depot;
+	FThreadCache Cache;
+	bool bThreadExited = false;
+	FPoolCounters Counters;
+
+	FImpl(const TCHAR* InSizeClasses, int32 InThreadCacheSize)
+		: Config(/* bInEnabled */ true, InSizeClasses, InThreadCacheSize)
+	{
+	}
+
+	FPoolContext GetContext()
+	{
+		return FPoolContext{ FPoolConfig::Get(Latched), Depot, bThreadExited ? nullptr : &Cache, Counters };
+	}
+};
+
+VariadicStruct::Pool::Private::FTestPool::FTestPool(const TCHAR* InSizeClasses, int32 InThreadCacheSize)
+	: Impl(MakeUnique<FImpl>(InSizeClasses, InThreadCacheSize))
+{
+}
+
+VariadicStruct::Pool::Private::FTestPool::~FTestPool()
+{
+	Impl->Cache.Flush(Impl->Depot);
+	Impl->Depot.FreeAll();
+}
+
+bool VariadicStruct::Pool::Private::FTestPool::Initialize()
+{
+	return FPoolConfig::Latch(Impl->Latched, &Impl->Config);
+}
+
+bool VariadicStruct::Pool::Private::FTestPool::IsEnabled() const
+{
+	return FPoolConfig::Get(Impl->Latched).bEnabled;
+}
+
+void* VariadicStruct::Pool::Private::FTestPool::Malloc(SIZE_T Size, uint32 Alignment)
+{
+	return PoolMalloc(Impl->GetContext(), Size, Alignment);
+}
+
+void VariadicStruct::Pool::Private::FTestPool::Free(void* Ptr, SIZE_T Size, uint32 Alignment)
+{
+	PoolFree(Impl->GetContext(), Ptr, Size, Alignment);
+}
+
+VariadicStruct::Pool::FStats VariadicStruct::Pool::Private::FTestPool::GetStats() const
+{
+	return Impl->Counters.GetStats();
+}
+
+uint32 VariadicStruct::Pool::Private::FTestPool::GetBlockSize(SIZE_T Size, uint32 Alignment) const
+{
+	const int32 Class = Impl->Config.FindClass(Size, Alignment);
+	return Class != INDEX_NONE ? Impl->Config.ClassSizes[Class] : 0;
+}
+
+int32 VariadicStruct::Pool::Private::FTestPool::GetNumCached(SIZE_T Size, bool bDepot) const
+{
+	const int32 Class = Impl->Config.FindClass(Size, BlockAlignment);
+	return Class == INDEX_NONE ? 0 : bDepot ? Impl->Depot.Num(Class) : Impl->Cache.Bins[Class].Num;
+}
+
+void VariadicStruct::Pool::Private::FTestPool::ExitThread()
+{
+	Impl->Cache.Flush(Impl->Depot);
+	Impl->bThreadExited = true;
+}
+
+void VariadicStruct::Pool::Private::FTestPool::StartThread()
+{
+	Impl->bThreadExited = false;
+}
+#endif // WITH_DEV_AUTOMATION_TESTS
+
+static FAutoConsoleCommand CmdPoolStats(
+	TEXT("VariadicStruct.Pool.Stats"),
+	TEXT("Logs the counters of the variadic struct payload pool."),
+	FConsoleCommandDelegate::CreateLambda([]
+		{
+			const VariadicStruct::Pool::FStats Stats = VariadicStruct::Pool::GetStats();
+			UE_LOG(LogVariadicStructPool, Display, TEXT("Enabled: %d, Allocs: %llu, CacheHits: %llu, DepotHits: %llu, Frees: %llu, HitRate: %.2f%%"),
+				   VariadicStruct::Pool::IsEnabled(), Stats.NumAllocs, Stats.NumCacheHits, Stats.NumDepotHits, Stats.NumFrees, Stats.GetHitRate() * 100.0);
+		}));
@@ -0,0 +1,319 @@
+// Copyright 2024 Ivan Baktenkov. All Rights Reserved.
+
+#include "VariadicStructTypeInfo.h"
+
+#include "Containers/Map.h"
+#include "Misc/ScopeRWLock.h"
+#include "UObject/GCObject.h"
+#include "UObject/ObjectKey.h"
+#include "UObject/UObjectGlobals.h"
+
+#include <atomic>
+
+VariadicStruct::FTypeInfo* VariadicStruct::Private::GTypeInfoChunks[TYPE_INFO_MAX_CHUNKS] = {};
+
+namespace
+{
+	using VariadicStruct::ETypeFlags;
+	using VariadicStruct::FTypeInfo;
+
+	/** Returns the flags of the reflection based descriptor, derived from StructFlags and the metadata. */
+	ETypeFlags GetScriptTypeFlags(const UScriptStruct* InScriptStruct)
+	{
+		ETypeFlags Flags = VariadicStruct::Private::GetScriptStructFlags(InScriptStruct);
+
+		// Reflected initialization of plain old data can be replaced with memcpy, only native types can't be reinstanced in place.
+		if (EnumHasAnyFlags(Flags, ETypeFlags::PlainOldData) && !EnumHasAnyFlags(Flags, ETypeFlags::ZeroConstructor) && (InScriptStruct->StructFlags & STRUCT_Native))
+		{
+			Flags |= ETypeFlags::DefaultSnapshot;
+		}
+
+#if WITH_METADATA
+		// Native types only follow TStorageHint, as their typed access resolves the placement at compile time.
+		if (!(InScriptStruct->StructFlags & STRUCT_Native) && InScriptStruct->GetMetaData(TEXT("VariadicStorage")) == TEXT("Heap"))
+		{
+			Flags |= ETypeFlags::ForceHeap;
+		}
+#endif // WITH_METADATA
+
+		return Flags;
+	}
+
+	/** Owns all FTypeInfo ever built, superseded ones are kept alive for the existing values. */
+	class FTypeRegistry
+	{
+	public:
+
+		static FTypeRegistry& Get()
+		{
+			static FTypeRegistry Registry;
+			return Registry;
+		}
+
+		/** Returns the current FTypeInfo of UScriptStruct if any. The lock needs to be held. */
+		const FTypeInfo* Find(const FObjectKey& Key) const
+		{
+			const FTypeInfo* const* const TypeInfo = TypeInfos.Find(Key);
+			return TypeInfo && IsUpToDate(**TypeInfo) ? *TypeInfo : nullptr;
+		}
+
+		/** Publishes FTypeInfo as the current one of its UScriptStruct. The write lock needs to be held. */
+		const FTypeInfo& Add(const FObjectKey& Key, const FTypeInfo& InTypeInfo)
+		{
+			using namespace VariadicStruct::Private;
+
+			const uint32 Index = NextIndex++;
+			checkf(Index >> TYPE_INFO_CHUNK_BITS < TYPE_INFO_MAX_CHUNKS, TEXT("FVariadicStruct: Ran out of type indices."));
+
+			FTypeInfo*& Chunk = GTypeInfoChunks[Index >> TYPE_INFO_CHUNK_BITS];
+
+			if (!Chunk)
+			{
+				SnapshotChunks[Index >> TYPE_INFO_CHUNK_BITS] = new std::atomic<void*>[TYPE_INFO_CHUNK_SIZE]();
+				Chunk = new FTypeInfo[TYPE_INFO_CHUNK_SIZE];
+			}
+
+			FTypeInfo& TypeInfo = Chunk[Index & (TYPE_INFO_CHUNK_SIZE - 1)];
+			TypeInfo = InTypeInfo;
+			TypeInfo.Index = Index;
+
+			TypeInfos.Add(Key, &TypeInfo);
+			return TypeInfo;
+		}
+
+		/** Returns the default snapshot slot of the descriptor. Doesn't need the lock, as the chunk is published before the index. */
+		std::atomic<void*>& GetSnapshot(uint32 Index)
+		{
+			using namespace VariadicStruct::Private;
+			return SnapshotChunks[Index >> TYPE_INFO_CHUNK_BITS][Index & (TYPE_INFO_CHUNK_SIZE - 1)];
+		}
+
+		/** Calls Func(TypeInfo, Snapshot) for each built default snapshot. The lock needs to be held. */
+		template<typename TFunc>
+		void ForEachSnapshot(TFunc&& Func)
+		{
+			for (uint32 Index = 1; Index < NextIndex; ++Index)
+			{
+				if (void* const Snapshot = GetSnapshot(Index).load(std::memory_order_acquire))
+				{
+					Func(*VariadicStruct::GetTypeInfoByIndex(Index), Snapshot);
+				}
+			}
+		}
+
+		FRWLock Lock;
+
+	private:
+
+		static bool IsUpToDate(const FTypeInfo& TypeInfo)
+		{
+#if WITH_EDITOR
+			// User defined structs can be recompiled in place, even with the same size, e.g. FString in place of the padding.
+			// Native types are only registered from their actual layout.
+			return TypeInfo.HasAnyFlags(ETypeFlags::Native)
+				|| (TypeInfo.Size == TypeInfo.ScriptStruct->GetStructureSize()
+					&& TypeInfo.Alignment == TypeInfo.ScriptStruct->GetMinAlignment()
+					&& TypeInfo.Flags == GetScriptTypeFlags(TypeInfo.ScriptStruct));
+#else
+			return true;
+#endif // WITH_EDITOR
+		}
+
+		/** FObjectKey protects from the address reuse after UDS got garbage collected. */
+		TMap<FObjectKey, const FTypeInfo*> TypeInfos;
+
+		/** Index of the next descriptor within GTypeInfoChunks, 0 is reserved for nullptr. */
+		uint32 NextIndex = 1;
+
+		/** Default snapshots indexed the same way as GTypeInfoChunks. Kept out of FTypeInfo to leave room for the ancestors. */
+		std::atomic<void*>* SnapshotChunks[VariadicStruct::Private::TYPE_INFO_MAX_CHUNKS] = {};
+	};
+
+	/** Reports the references of the default snapshots and drops them when the native code gets reloaded. */
+	class FDefaultSnapshotReferences final : public FGCObject
+	{
+	public:
+
+		/** Registers the instance on the first built snapshot, as the module might be loaded before the GC is initialized. */
+		static void Register()
+		{
+			static FDefaultSnapshotReferences References;
+		}
+
+		virtual void AddReferencedObjects(FReferenceCollector& Collector) override
+		{
+			FTypeRegistry& Registry = FTypeRegistry::Get();
+			FReadScopeLock ScopeLock(Registry.Lock);
+
+			// Snapshots are only built for native types, so the types themselves don't need to be referenced.
+			Registry.ForEachSnapshot([&Collector](const FTypeInfo& TypeInfo, void* Snapshot)
+				{
+					Collector.AddPropertyReferencesWithStructARO(TypeInfo.ScriptStruct, Snapshot);
+				});
+		}
+
+		virtual FString GetReferencerName() const override
+		{
+			return TEXT("FVariadicStruct default snapshots");
+		}
+
+	private:
+
+		FDefaultSnapshotReferences()
+		{
+#if WITH_RELOAD
+			// Constructors might have been patched, the snapshots are rebuilt on the next use.
+			FCoreUObjectDelegates::ReloadCompleteDelegate.AddLambda([](EReloadCompleteReason)
+				{
+					FTypeRegistry& Registry = FTypeRegistry::Get();
+					FWriteScopeLock ScopeLock(Registry.Lock);
+
+					Registry.ForEachSnapshot([&Registry](const FTypeInfo& TypeInfo, void* Snapshot)
+						{
+							Registry.GetSnapshot(TypeInfo.Index).store(nullptr, std::memory_order_release);
+							TypeInfo.DestroyValue(Snapshot);
+							FMemory::Free(Snapshot);
+						});
+				});
+#endif // WITH_RELOAD
+		}
+	};
+
+	/** Builds FTypeInfo with the operations going through the reflection. */
+	FTypeInfo MakeScriptTypeInfo(const UScriptStruct* InScriptStruct)
+	{
+		FTypeInfo TypeInfo;
+		TypeInfo.ScriptStruct = InScriptStruct;
+		TypeInfo.Size = InScriptStruct->GetStructureSize();
+		TypeInfo.Alignment = InScriptStruct->GetMinAlignment();
+		TypeInfo.Flags = GetScriptTypeFlags(InScriptStruct);
+		VariadicStruct::Private::InitializeAncestors(TypeInfo);
+
+		TypeInfo.Construct = [](const FTypeInfo& InTypeInfo, void* Dest)
+		{
+			InTypeInfo.ScriptStruct->InitializeStruct(Dest);
+		};
+
+		if (TypeInfo.HasAnyFlags(ETypeFlags::PlainOldData))
+		{
+			TypeInfo.Copy = [](const FTypeInfo& InTypeInfo, void* Dest, const void* Src)
+			{
+				FMemory::Memcpy(Dest, Src, InTypeInfo.Size);
+			};
+
+			// Default construction is redundant as the value is overwritten anyway.
+			TypeInfo.CopyConstruct = TypeInfo.Copy;
+		}
+		else
+		{
+			TypeInfo.Copy = [](const FTypeInfo& InTypeInfo, void* Dest, const void* Src)
+			{
+				InTypeInfo.ScriptStruct->CopyScriptStruct(Dest, Src);
+			};
+
+			// ICppStructOps doesn't expose a copy constructor, the native one is bound once the type is used natively.
+			TypeInfo.CopyConstruct = [](const FTypeInfo& InTypeInfo, void* Dest, const void* Src)
+			{
+				InTypeInfo.ScriptStruct->InitializeStruct(Dest);
+				InTypeInfo.ScriptStruct->CopyScriptStruct(Dest, Src);
+			};
+		}
+
+		if (TypeInfo.HasAnyFlags(ETypeFlags::TriviallyRelocatable))
+		{
+			TypeInfo.Relocate = [](const FTypeInfo& InTypeInfo, void* Dest, void* Src)
+			{
+				FMemory::Memcpy(Dest, Src, InTypeInfo.Size);
+			};
+		}
+		else
+		{
+			TypeInfo.Relocate = [](const FTypeInfo& InTypeInfo, void* Dest, void* Src)
+			{
+				InTypeInfo.CopyConstruct(InTypeInfo, Dest, Src);
+				InTypeInfo.ScriptStruct->DestroyStruct(Src);
+			};
+		}
+
+		TypeInfo.Destroy = [](const FTypeInfo& InTypeInfo, void* Dest)
+		{
+			InTypeInfo.ScriptStruct->DestroyStruct(Dest);
+		};
+
+		return TypeInfo;
+	}
+}
+
+const VariadicStruct::FTypeInfo* VariadicStruct::FindOrAddTypeInfo(const UScriptStruct* InScriptStruct)
+{
+	if (!InScriptStruct)
+	{
+		return nullptr;
+	}
+
+	FTypeRegistry& Registry = FTypeRegistry::Get();
+	const FObjectKey Key(InScriptStruct);
+
+	{
+		FReadScopeLock ScopeLock(Registry.Lock);
+
+		if (const FTypeInfo* const TypeInfo = Registry.Find(Key))
+		{
+			return TypeInfo;
+		}
+	}
+
+	FWriteScopeLock ScopeLock(Registry.Lock);
+
+	// Might have been added while the lock was released.
+	if (const FTypeInfo* const TypeInfo = Registry.Find(Key))
+	{
+		return TypeInfo;
+	}
+
+	return &Registry.Add(Key, MakeScriptTypeInfo(InScriptStruct));
+}
+
+const VariadicStruct::FTypeInfo& VariadicStruct::Private::RegisterNativeTypeInfo(const FTypeInfo& InTypeInfo)
+{
+	check(InTypeInfo.ScriptStruct && InTypeInfo.HasAnyFlags(ETypeFlags::Native));
+
+	FTypeRegistry& Registry = FTypeRegistry::Get();
+	const FObjectKey Key(InTypeInfo.ScriptStruct);
+
+	FWriteScopeLock ScopeLock(Registry.Lock);
+
+	// Each module instantiates its own static, but all of them share the first native registration.
+	if (const FTypeInfo* const TypeInfo = Registry.Find(Key); TypeInfo && TypeInfo->HasAnyFlags(ETypeFlags::Native))
+	{
+		return *TypeInfo;
+	}
+
+	return Registry.Add(Key, InTypeInfo);
+}
+
+const void* VariadicStruct::Private::GetDefaultSnapshot(const FTypeInfo& InTypeInfo)
+{
+	checkSlow(InTypeInfo.HasAnyFlags(ETypeFlags::DefaultSnapshot));
+
+	std::atomic<void*>& Snapshot = FTypeRegistry::Get().GetSnapshot(InTypeInfo.Index);
+
+	if (void* const ExistingSnapshot = Snapshot.load(std::memory_order_acquire))
+	{
+		return ExistingSnapshot;
+	}
+
+	void* const NewSnapshot = FMemory::Malloc(InTypeInfo.Size, InTypeInfo.Alignment);
+	InTypeInfo.Construct(InTypeInfo, NewSnapshot);
+
+	// Another thread might have built it in the meantime.
+	if (void* ExistingSnapshot = nullptr; !Snapshot.compare_exchange_strong(ExistingSnapshot, NewSnapshot, std::memory_order_acq_rel, std::memory_order_acquire))
+	{
+		InTypeInfo.DestroyValue(NewSnapshot);
+		FMemory::Free(NewSnapshot);
+		return ExistingSnapshot;
+	}
+
+	FDefaultSnapshotReferences::Register();
+	return NewSnapshot;
+}
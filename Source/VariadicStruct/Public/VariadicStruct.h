@@ -3,26 +3,33 @@
 #pragma once
 
 #include "Containers/Array.h"
+#include "Containers/ArrayView.h"
 #include "CoreTypes.h"
 #include "HAL/UnrealMemory.h"
 #include "Misc/AssertionMacros.h"
 #include "Misc/EngineVersionComparison.h"
 #include "Serialization/StructuredArchive.h"
+#include "Templates/AlignmentTemplates.h"
 #include "UObject/Class.h"
 #include "UObject/NameTypes.h"
 #include "UObject/ObjectPtr.h"
 #include "UObject/PropertyPortFlags.h"
+#include "VariadicStructAllocators.h"
+#include "VariadicStructTypeInfo.h"
 
 #if UE_VERSION_OLDER_THAN(5, 5, 0)
+#include "InstancedStruct.h"
 #include "StructView.h"
 #else
+#include "StructUtils/InstancedStruct.h"
 #include "StructUtils/StructView.h"
 #include "Templates/Function.h"
 #endif // UE_VERSION_OLDER_THAN
 
 #include <concepts>
-#include <memory> // std::destroy_at
-#include <new>	  // std::launder
+#include <cstddef> // offsetof()
+#include <memory>  // std::destroy_at
+#include <new>	   // std::launder
 
 #include "VariadicStruct.generated.h"
 
@@ -38,6 +45,9 @@ struct FPropertyTag;
 struct FPropertyVisitorData;
 struct FPropertyVisitorInfo;
 struct FPropertyVisitorPath;
+struct FCompactVariadicStruct;
+struct FPackedVariadicStruct;
+struct FVariadicStruct;
 
 enum class EPropertyVisitorControlFlow : uint8;
 
@@ -47,7 +57,7 @@ namespace VariadicStruct
 	struct TypePack final {};
 
 	/** List of unsupported types for FVariadicStruct. */
-	using UnsupportedTypes = TypePack<FVariadicStruct, FInstancedStruct, FSharedStruct, FConstSharedStruct>;
+	using UnsupportedTypes = TypePack<FVariadicStruct, FCompactVariadicStruct, FPackedVariadicStruct, FInstancedStruct, FSharedStruct, FConstSharedStruct>;
 
 	/** Generic concept of UScriptStruct wrappers. */
 	template<typename T>
@@ -89,73 +99,271 @@ namespace VariadicStruct
 
 	/** Validates UScriptStruct to be used with FVariadicStruct. */
 	bool ValidateScriptStruct(const UScriptStruct* InScriptStruct);
+
+	namespace Private
+	{
+		/**
+		 * Type-erased reference to any TVariadicStruct layout.
+		 * Allows all layouts to share the reflection heavy implementation of StructOpsTypeTraits.
+		 */
+		struct FVariadicRef
+		{
+			struct FOps
+			{
+				const UScriptStruct* (*GetScriptStruct)(const void* Variadic);
+				uint8* (*GetMutableMemory)(void* Variadic);
+				void (*InitializeAs)(void* Variadic, const UScriptStruct* InScriptStruct, const uint8* InStructMemory);
+				void (*ReplaceScriptStruct)(void* Variadic, const UScriptStruct* InScriptStruct);
+			};
+
+			void* Variadic = nullptr;
+			const FOps* Ops = nullptr;
+
+			const UScriptStruct* GetScriptStruct() const
+			{
+				return Ops->GetScriptStruct(Variadic);
+			}
+
+			uint8* GetMutableMemory() const
+			{
+				return Ops->GetMutableMemory(Variadic);
+			}
+
+			void InitializeAs(const UScriptStruct* InScriptStruct, const uint8* InStructMemory = nullptr) const
+			{
+				Ops->InitializeAs(Variadic, InScriptStruct, InStructMemory);
+			}
+
+			/** Replaces the type without touching the value. Only valid for types with identical layouts, e.g. UDS reinstancing. */
+			void ReplaceScriptStruct(const UScriptStruct* InScriptStruct) const
+			{
+				Ops->ReplaceScriptStruct(Variadic, InScriptStruct);
+			}
+		};
+
+		/** Exposes the protected storage of FInstancedStruct to hand over its heap memory without copying. */
+		struct FInstancedStructAccess : FInstancedStruct
+		{
+			/** Leaves FInstancedStruct empty without destroying the value and returns its memory. */
+			static uint8* Detach(FInstancedStruct& InInstancedStruct)
+			{
+				uint8* const MemoryPtr = InInstancedStruct.*(&FInstancedStructAccess::StructMemory);
+				InInstancedStruct.*(&FInstancedStructAccess::StructMemory) = nullptr;
+				InInstancedStruct.*(&FInstancedStructAccess::ScriptStruct) = nullptr;
+				return MemoryPtr;
+			}
+
+			/** Hands over the value allocated with FMemory to the empty FInstancedStruct. */
+			static void Attach(FInstancedStruct& InInstancedStruct, const UScriptStruct* InScriptStruct, uint8* InStructMemory)
+			{
+				check(!InInstancedStruct.IsValid());
+				InInstancedStruct.*(&FInstancedStructAccess::ScriptStruct) = InScriptStruct;
+				InInstancedStruct.*(&FInstancedStructAccess::StructMemory) = InStructMemory;
+			}
+		};
+
+		// Out-of-line implementation of StructOpsTypeTraits shared by all layouts.
+		VARIADICSTRUCT_API bool Serialize(FVariadicRef Variadic, FArchive& Ar, const FConstStructView* Defaults);
+		VARIADICSTRUCT_API void AddStructReferencedObjects(FVariadicRef Variadic, FReferenceCollector& Collector);
+		VARIADICSTRUCT_API bool ExportTextItem(FVariadicRef Variadic, FString& ValueStr, UObject* Parent, int32 PortFlags, UObject* ExportRootScope);
+		VARIADICSTRUCT_API bool ImportTextItem(FVariadicRef Variadic, const TCHAR*& Buffer, int32 PortFlags, UObject* Parent, FOutputDevice* ErrorText);
+		VARIADICSTRUCT_API bool SerializeFromMismatchedTag(FVariadicRef Variadic, const FPropertyTag& Tag, FStructuredArchive::FSlot Slot);
+		VARIADICSTRUCT_API void GetPreloadDependencies(FVariadicRef Variadic, TArray<UObject*>& OutDeps);
+		VARIADICSTRUCT_API bool NetSerialize(FVariadicRef Variadic, FArchive& Ar, UPackageMap* Map, bool& bOutSuccess);
+		VARIADICSTRUCT_API bool FindInnerPropertyInstance(FVariadicRef Variadic, FName PropertyName, const FProperty*& OutProp, const void*& OutData);
+#if !UE_VERSION_OLDER_THAN(5, 5, 0)
+		VARIADICSTRUCT_API EPropertyVisitorControlFlow Visit(FVariadicRef Variadic, FPropertyVisitorPath& Path, const FPropertyVisitorData& Data, const TFunctionRef<EPropertyVisitorControlFlow(const FPropertyVisitorPath& /*Path*/, const FPropertyVisitorData& /*Data*/)> InFunc);
+		VARIADICSTRUCT_API void* ResolveVisitedPathInfo(FVariadicRef Variadic, const FPropertyVisitorInfo& Info);
+#endif // UE_VERSION_OLDER_THAN
+	}
 }
 
 /**
- * Implementation of FInstancedStruct with SBO (Small Buffer Optimization) with default buffer size of 24 bytes.
+ * Implementation of FInstancedStruct with SBO (Small Buffer Optimization) with a configurable buffer size and alignment.
  * Particularly useful when the expected types rarely exceed the buffer size, such as optional payload data.
  * Serialization compatible (non-commutative) with FInstancedStruct.
  *
- * FVariadicStruct has some key differences from FInstancedStruct that should be taken into account:
- * 1. Requires 32 bytes instead of 16 and 16-byte alignment instead of 8.
- * 2. Requires extra steps to access the data including 1 branching and 1 indirection if the type doesn't match.
- * 3. Move constructor and move assignment operator require a copy constructor for types that fit into the buffer.
+ * TVariadicStruct has some key differences from FInstancedStruct that should be taken into account:
+ * 1. Requires BufferSize + sizeof(TypeHandle) bytes, i.e. + 8 for FTypePtrHandle or + 4 for FTypeIndexHandle, instead of 16 and InAlignment instead of 8.
+ * 2. Requires extra steps to access the data including 1 branching and 1 indirection to the cached type descriptor if the type doesn't match,
+ *    or 2 with FTypeIndexHandle which goes through the registry chunks.
+ *    Untyped access to the memory doesn't touch the type, the storage mode is tagged in the low bit of the type pointer.
+ * 3. Move constructor and move assignment operator use the native move constructor for types that fit into the buffer
+ *    if the type was initialized natively, e.g. InitializeAs<T>(), or memcpy if it's declared as VariadicStruct::TIsTriviallyRelocatable.
+ *    Types only known to the reflection are copied, as UScriptStruct doesn't expose the move operations.
  * 4. Similar to FInstancedStructContainer, not exposed to the Editor and BP as it doesn't make much sense.
  *
+ * Any layout can be used natively as is, e.g. TVariadicStruct<56> for payloads up to 56 bytes within 64 bytes.
+ * Exposing a layout to the reflection requires a USTRUCT deriving from TVariadicStruct with InDerivedType set to itself,
+ * and TStructOpsTypeTraits deriving from TVariadicStructOpsTypeTraits. See FVariadicStruct.
+ *
+ * @param InBufferSize - Size of the inline buffer. Must keep the struct effectively sized, e.g. 24, 40 or 56 for 16-byte alignment.
+ * @param InAlignment - Alignment of the inline buffer. Types with a greater alignment are allocated on the heap.
+ * @param InDerivedType - Optional type deriving from TVariadicStruct which is returned by the factories.
+ * @param InTypeHandle - Storage of the type, either 64-bit VariadicStruct::FTypePtrHandle or 32-bit VariadicStruct::FTypeIndexHandle.
+ * @param InAllocator - Allocator of the payloads exceeding the buffer, e.g. VariadicStruct::FMemStackAllocator. See VariadicStructAllocators.h.
+ *
  * @Note: FInstancedStructContainer might still be more preferable for contiguous heterogeneous data.
  */
-USTRUCT()
-struct alignas(16) VARIADICSTRUCT_API FVariadicStruct
+template<int32 InBufferSize, int32 InAlignment = 16, typename InDerivedType = void, typename InTypeHandle = VariadicStruct::FTypePtrHandle, typename InAllocator = VariadicStruct::FHeapAllocator>
+struct alignas(InAlignment) TVariadicStruct
 {
-	GENERATED_BODY()
-
 public:
 
-	FVariadicStruct() = default;
-	FVariadicStruct(FVariadicStruct&& InOther);
-	FVariadicStruct(const FVariadicStruct& InOther);
-	FVariadicStruct& operator=(FVariadicStruct&& InOther);
-	FVariadicStruct& operator=(const FVariadicStruct& InOther);
+	/** Type constructed by the factories. */
+	using FDerivedType = std::conditional_t<std::is_void_v<InDerivedType>, TVariadicStruct, InDerivedType>;
+
+	/** Allocator of the payloads exceeding the buffer. */
+	using FAllocator = InAllocator;
+
+	/** Size of the inline buffer. */
+	static inline constexpr int32 BUFFER_SIZE = InBufferSize;
+
+	/** Max alignment of the types stored in the inline buffer. */
+	static inline constexpr int32 ALIGNMENT = InAlignment;
+
+	/** Min alignment of the heap memory, so it can be reused by the types up to this alignment. */
+	static inline constexpr uint32 MIN_HEAP_ALIGNMENT = 16;
+
+	/** Releases the memory passed to Adopt() once the value is destroyed. */
+	using FDeleter = void (*)(uint8* Memory);
+
+	/** Whether the buffer can store the deleter of the adopted memory after the heap memory pointer and capacity. */
+	static inline constexpr bool SUPPORTS_ADOPTION = InBufferSize >= sizeof(uint8*) + sizeof(uint32) + sizeof(FDeleter);
+
+	/** Value handed over by Release(), which needs to be destroyed and freed with the deleter by the caller. */
+	struct FReleasedStruct
+	{
+		const UScriptStruct* ScriptStruct = nullptr;
+		uint8* Memory = nullptr;
+		FDeleter Deleter = nullptr;
+	};
+
+	// The following requirements needs to be met in order to avoid using std::align() to access the underlying structure memory.
+	static_assert(InAlignment >= 8 && (InAlignment & (InAlignment - 1)) == 0, "TVariadicStruct: Alignment needs to be a power of two and at least 8.");
+	static_assert(InBufferSize >= sizeof(uint8*) + sizeof(uint32), "TVariadicStruct: BufferSize needs to fit the heap memory pointer and capacity.");
+	static_assert((InBufferSize + sizeof(InTypeHandle)) % InAlignment == 0, "TVariadicStruct: Needs to be effectively sized, (BufferSize + sizeof(TypeHandle)) must be a multiple of Alignment.");
+
+	TVariadicStruct()
+	{
+		ResetStructData();
+	}
+
+	TVariadicStruct(TVariadicStruct&& InOther)
+	{
+		if (!InOther.IsBitwiseRelocatable())
+		{
+			// Move construct within the buffer, otherwise memcpy will break pointers to itself within the struct (std::list).
+			const VariadicStruct::FTypeInfo* const TypeInfo = InOther.GetTypeInfo();
+			TypeInfo->Relocate(*TypeInfo, StructBuffer, InOther.StructBuffer);
+			TypeHandle = InOther.TypeHandle;
+
+			// Invalidate other data.
+			InOther.ResetStructData();
+		}
+		else
+		{
+			// Relocate the buffer or take ownership of the heap memory.
+			RelocateFrom(InOther);
+		}
+	}
+
+	TVariadicStruct(const TVariadicStruct& InOther)
+	{
+		InitializeAsTypeInfo(InOther.GetTypeInfo(), InOther.GetMemory());
+	}
+
+	TVariadicStruct& operator=(TVariadicStruct&& InOther)
+	{
+		if (this != &InOther)
+		{
+			if (!InOther.IsBitwiseRelocatable())
+			{
+				// Invalidate data and release memory.
+				Reset();
+
+				// Move construct within the buffer, otherwise memcpy will break pointers to itself within the struct (std::list).
+				const VariadicStruct::FTypeInfo* const TypeInfo = InOther.GetTypeInfo();
+				TypeInfo->Relocate(*TypeInfo, StructBuffer, InOther.StructBuffer);
+				TypeHandle = InOther.TypeHandle;
+
+				// Invalidate data.
+				InOther.ResetStructData();
+			}
+			else
+			{
+				// Invalidate data and release memory.
+				Reset();
+
+				// Relocate the buffer or take ownership of the heap memory.
+				RelocateFrom(InOther);
+			}
+		}
+
+		return *this;
+	}
+
+	TVariadicStruct& operator=(const TVariadicStruct& InOther)
+	{
+		if (this != &InOther)
+		{
+			InitializeAsTypeInfo(InOther.GetTypeInfo(), InOther.GetMemory());
+		}
+
+		return *this;
+	}
 
 	/** FVariadicStruct::Make() should be used instead. */
-	FVariadicStruct(const FInstancedStruct&)   = delete;
-	FVariadicStruct(const FSharedStruct&)	   = delete;
-	FVariadicStruct(const FConstSharedStruct&) = delete;
-	FVariadicStruct(const FStructView&)		   = delete;
-	FVariadicStruct(const FConstStructView&)   = delete;
+	TVariadicStruct(const FInstancedStruct&)   = delete;
+	TVariadicStruct(const FSharedStruct&)	   = delete;
+	TVariadicStruct(const FConstSharedStruct&) = delete;
+	TVariadicStruct(const FStructView&)		   = delete;
+	TVariadicStruct(const FConstStructView&)   = delete;
+
+	~TVariadicStruct()
+	{
+		// Validated here as the type is complete at this point.
+		static_assert(std::is_standard_layout_v<TVariadicStruct> && offsetof(TVariadicStruct, StructBuffer) == 0, "TVariadicStruct::StructBuffer needs to be the first member property.");
+		static_assert(sizeof(TVariadicStruct) == BUFFER_SIZE + sizeof(InTypeHandle), "TVariadicStruct: Unexpected padding.");
 
-	~FVariadicStruct() { Reset(); }
+		Reset();
+	}
 
 	/** Initializes from struct template type and optional params in place. */
 	template<VariadicStruct::CSupportedType T, typename... TArgs>
 	T* InitializeAs(TArgs&&... InArgs)
 	{
 		uint8* MemoryPtr = StructBuffer;
+		const VariadicStruct::FTypeInfo& InTypeInfo = VariadicStruct::GetTypeInfo<T>();
 
-		// If the existing type is valid and matches.
-		if (const UScriptStruct* const InScriptStruct = TBaseStructure<T>::Get(); InScriptStruct == ScriptStruct)
+		// If the existing type is valid and matches. The values forced to the heap might have been stored inline by the reflection based descriptor.
+		if (const VariadicStruct::FTypeInfo* const TypeInfo = GetTypeInfo(); (TypeInfo == &InTypeInfo || (TypeInfo && TypeInfo->ScriptStruct == InTypeInfo.ScriptStruct)) && (!IsForcedToHeap<T>() || !IsInline()))
 		{
 			// We can reuse the same memory.
 			if constexpr (TypeRequiresMemoryAllocation<T>())
 			{
-				MemoryPtr = StructMemory;
+				MemoryPtr = GetStructMemory();
 			}
 
 			// Destroy the existing struct directly.
 			std::destroy_at(VariadicStruct::GetTypedPtr<T>(MemoryPtr));
+
+			// Prefer the native operations, the layout is the same.
+			SetTypeInfo(&InTypeInfo, !TypeRequiresMemoryAllocation<T>());
 		}
 		else
 		{
-			Reset();
-
-			ScriptStruct = InScriptStruct;
-
-			// Allocate a new space if the buffer is too small.
+			// Allocate a new space if the buffer is too small, or reuse the existing one if it fits.
 			if constexpr (TypeRequiresMemoryAllocation<T>())
 			{
-				MemoryPtr = StructMemory = static_cast<uint8*>(FMemory::Malloc(sizeof(T), alignof(T)));
-				checkSlow(MemoryPtr != nullptr);
+				MemoryPtr = ReinitializeHeapMemory(sizeof(T), alignof(T));
+			}
+			else
+			{
+				Reset();
 			}
+
+			SetTypeInfo(&InTypeInfo, !TypeRequiresMemoryAllocation<T>());
 		}
 
 		// Return the value pointer avoiding std::launder() if the type is immediately used.
@@ -163,41 +371,213 @@ public:
 	}
 
 	/** Initializes from UScriptStruct type and copies the value if needed. */
-	void InitializeAs(const UScriptStruct* InScriptStruct, const uint8* InStructMemory = nullptr);
+	void InitializeAs(const UScriptStruct* InScriptStruct, const uint8* InStructMemory = nullptr)
+	{
+		checkf(VariadicStruct::ValidateScriptStruct(InScriptStruct), TEXT("FVariadicStruct: Trying to init with unsupported UScriptStruct."));
+
+		// Avoid the registry lookup if the type matches.
+		InitializeAsTypeInfo(GetScriptStruct() == InScriptStruct ? GetTypeInfo() : VariadicStruct::FindOrAddTypeInfo(InScriptStruct), InStructMemory);
+	}
+
+	/**
+	 * Takes over the value of FInstancedStruct leaving it empty.
+	 * The heap memory is adopted if the value requires the heap, i.e. exceeds the buffer or is ForceHeap, the memory is at least MIN_HEAP_ALIGNMENT aligned
+	 * and IsInstancedStructCompatible(), otherwise the value is relocated.
+	 */
+	void InitializeAs(FInstancedStruct&& InInstancedStruct)
+	{
+		using FAccess = VariadicStruct::Private::FInstancedStructAccess;
+
+		checkf(VariadicStruct::ValidateScriptStruct(InInstancedStruct.GetScriptStruct()), TEXT("FVariadicStruct: Trying to init with unsupported UScriptStruct."));
+
+		const VariadicStruct::FTypeInfo* const InTypeInfo = VariadicStruct::FindOrAddTypeInfo(InInstancedStruct.GetScriptStruct());
+		Reset();
+
+		if (!InTypeInfo)
+		{
+			return;
+		}
+
+		uint8* const InStructMemory = FAccess::Detach(InInstancedStruct);
+
+		if (!RequiresMemoryAllocation(*InTypeInfo))
+		{
+			SetTypeInfo(InTypeInfo, true);
+			InTypeInfo->Relocate(*InTypeInfo, StructBuffer, InStructMemory);
+			FMemory::Free(InStructMemory);
+		}
+		else if (IsInstancedStructCompatible() && IsAligned(InStructMemory, MIN_HEAP_ALIGNMENT))
+		{
+			// FInstancedStruct only requests the alignment of the type, so the memory is adopted if it's aligned as our own, as ReinitializeHeapMemory() reuses it for any type up to MIN_HEAP_ALIGNMENT.
+			SetHeapMemory(InStructMemory, InTypeInfo->Size);
+			SetTypeInfo(InTypeInfo, false);
+		}
+		else
+		{
+			uint8* const MemoryPtr = ReinitializeHeapMemory(InTypeInfo->Size, InTypeInfo->Alignment);
+			SetTypeInfo(InTypeInfo, false);
+			InTypeInfo->Relocate(*InTypeInfo, MemoryPtr, InStructMemory);
+			FMemory::Free(InStructMemory);
+		}
+	}
+
+	/**
+	 * Moves the value into FInstancedStruct leaving this empty.
+	 * The heap memory is handed over if IsInstancedStructCompatible(), otherwise the value is relocated.
+	 */
+	[[nodiscard]] FInstancedStruct ReleaseToInstancedStruct()
+	{
+		using FAccess = VariadicStruct::Private::FInstancedStructAccess;
+
+		FInstancedStruct InstancedStruct;
+
+		if (const VariadicStruct::FTypeInfo* const TypeInfo = GetTypeInfo())
+		{
+			if (!IsInline() && !IsExternalHeapMemory() && IsInstancedStructCompatible())
+			{
+				FAccess::Attach(InstancedStruct, TypeInfo->ScriptStruct, GetStructMemory());
+			}
+			else
+			{
+				// Same as FInstancedStruct allocates.
+				uint8* const MemoryPtr = static_cast<uint8*>(FMemory::Malloc(FMath::Max(1, TypeInfo->Size), TypeInfo->Alignment));
+				TypeInfo->Relocate(*TypeInfo, MemoryPtr, GetMutableMemory());
+
+				if (!IsInline())
+				{
+					FreeHeapMemory(*TypeInfo, GetStructMemory());
+				}
+
+				FAccess::Attach(InstancedStruct, TypeInfo->ScriptStruct, MemoryPtr);
+			}
+
+			ResetStructData();
+		}
+
+		return InstancedStruct;
+	}
+
+	/**
+	 * Takes ownership of the value already constructed in external memory, e.g. by a decoder, without copying.
+	 * The memory needs to fit the type and be aligned for it. InDeleter is called after the value is destroyed.
+	 * Types fitting into the buffer are relocated into it and the memory is released right away.
+	 */
+	void Adopt(const UScriptStruct* InScriptStruct, uint8* InStructMemory, FDeleter InDeleter)
+	{
+		static_assert(SUPPORTS_ADOPTION, "TVariadicStruct: BufferSize is too small to store the deleter.");
+		checkf(VariadicStruct::ValidateScriptStruct(InScriptStruct), TEXT("FVariadicStruct: Trying to init with unsupported UScriptStruct."));
+		check(InDeleter && (InStructMemory || !InScriptStruct));
+
+		const VariadicStruct::FTypeInfo* const InTypeInfo = VariadicStruct::FindOrAddTypeInfo(InScriptStruct);
+		Reset();
+
+		if (!InTypeInfo)
+		{
+			return;
+		}
+
+		if (!RequiresMemoryAllocation(*InTypeInfo))
+		{
+			SetTypeInfo(InTypeInfo, true);
+			InTypeInfo->Relocate(*InTypeInfo, StructBuffer, InStructMemory);
+			InDeleter(InStructMemory);
+		}
+		else
+		{
+			// Zero capacity marks the external memory, which is never reused.
+			SetHeapMemory(InStructMemory, 0);
+			FMemory::Memcpy(StructBuffer + DELETER_OFFSET, &InDeleter, sizeof(InDeleter));
+			SetTypeInfo(InTypeInfo, false);
+		}
+	}
+
+	/**
+	 * Hands over the value leaving this empty, the caller becomes responsible for destroying and freeing it.
+	 * The adopted memory is returned as is, as well as the own heap memory if IsInstancedStructCompatible(). Otherwise, the value is relocated.
+	 */
+	[[nodiscard]] FReleasedStruct Release()
+	{
+		FReleasedStruct Released;
+
+		if (const VariadicStruct::FTypeInfo* const TypeInfo = GetTypeInfo())
+		{
+			Released.ScriptStruct = TypeInfo->ScriptStruct;
+
+			if (!IsInline() && IsExternalHeapMemory())
+			{
+				Released.Memory = GetStructMemory();
+				Released.Deleter = GetDeleter();
+			}
+			else if (!IsInline() && IsInstancedStructCompatible())
+			{
+				Released.Memory = GetStructMemory();
+				Released.Deleter = [](uint8* Memory) { FMemory::Free(Memory); };
+			}
+			else
+			{
+				Released.Memory = static_cast<uint8*>(FMemory::Malloc(FMath::Max(1, TypeInfo->Size), TypeInfo->Alignment));
+				Released.Deleter = [](uint8* Memory) { FMemory::Free(Memory); };
+				TypeInfo->Relocate(*TypeInfo, Released.Memory, GetMutableMemory());
+
+				if (!IsInline())
+				{
+					FreeHeapMemory(*TypeInfo, GetStructMemory());
+				}
+			}
+
+			ResetStructData();
+		}
+
+		return Released;
+	}
+
+	/** Whether the heap memory can be handed over to and from FInstancedStruct, i.e. it's allocated directly with FMemory. */
+	static bool IsInstancedStructCompatible()
+	{
+		return std::is_same_v<FAllocator, VariadicStruct::FHeapAllocator> && !VariadicStruct::Pool::IsEnabled();
+	}
 
 public: // Factories
 
 	/** Copy/move constructs a new FVariadicStruct from a template struct. */
 	template<typename T> requires(VariadicStruct::CSupportedType<std::remove_cvref_t<T>>)
-	[[nodiscard]] static FVariadicStruct Make(T&& InStruct)
+	[[nodiscard]] static FDerivedType Make(T&& InStruct)
 	{
-		FVariadicStruct Variadic;
-		Variadic.InitializeAs<std::remove_cvref_t<T>>(Forward<T>(InStruct));
+		FDerivedType Variadic;
+		Variadic.template InitializeAs<std::remove_cvref_t<T>>(Forward<T>(InStruct));
 		return Variadic;
 	}
 
 	/** Emplace constructs a new FVariadicStruct from a template struct type and arguments. */
 	template<VariadicStruct::CSupportedType T, typename... TArgs>
-	[[nodiscard]] static FVariadicStruct Make(TArgs&&... InArgs)
+	[[nodiscard]] static FDerivedType Make(TArgs&&... InArgs)
 	{
-		FVariadicStruct Variadic;
-		Variadic.InitializeAs<T>(Forward<TArgs>(InArgs)...);
+		FDerivedType Variadic;
+		Variadic.template InitializeAs<T>(Forward<TArgs>(InArgs)...);
 		return Variadic;
 	}
 
 	/** Default constructs a new FVariadicStruct from UScriptStruct and copies the value if needed. */
-	[[nodiscard]] static FVariadicStruct Make(const UScriptStruct* InScriptStruct, const uint8* InStructMemory = nullptr)
+	[[nodiscard]] static FDerivedType Make(const UScriptStruct* InScriptStruct, const uint8* InStructMemory = nullptr)
 	{
-		FVariadicStruct Variadic;
+		FDerivedType Variadic;
 		Variadic.InitializeAs(InScriptStruct, InStructMemory);
 		return Variadic;
 	}
 
+	/** Moves FInstancedStruct into a new FVariadicStruct adopting the heap memory if possible, see InitializeAs(FInstancedStruct&&). */
+	[[nodiscard]] static FDerivedType Make(FInstancedStruct&& InInstancedStruct)
+	{
+		FDerivedType Variadic;
+		Variadic.InitializeAs(MoveTemp(InInstancedStruct));
+		return Variadic;
+	}
+
 	/** Default constructs a new FVariadicStruct from a generic struct wrapper. */
 	template<VariadicStruct::CScriptStructWrapper T>
-	[[nodiscard]] static FVariadicStruct Make(const T& InStructWrapper)
+	[[nodiscard]] static FDerivedType Make(const T& InStructWrapper)
 	{
-		FVariadicStruct Variadic;
+		FDerivedType Variadic;
 		Variadic.InitializeAs(InStructWrapper.GetScriptStruct(), InStructWrapper.GetMemory());
 		return Variadic;
 	}
@@ -208,19 +588,22 @@ public: // Data Access
 	template<VariadicStruct::CSupportedType T, bool bExactType = false>
 	[[nodiscard]] bool IsTypeOf() const
 	{
-		return TBaseStructure<T>::Get() == ScriptStruct || (!bExactType && ScriptStruct && ScriptStruct->IsChildOf(TBaseStructure<T>::Get()));
+		const UScriptStruct* const ScriptStruct = GetScriptStruct();
+		return VariadicStruct::GetStaticStruct<T>() == ScriptStruct || (!bExactType && IsChildOfType<T>());
 	}
 
 	/** Returns a const pointer to the struct value, or nullptr if the type doesn't match. */
 	template<VariadicStruct::CSupportedType T, bool bExactType = false>
 	[[nodiscard]] const T* GetValuePtr() const
 	{
+		const UScriptStruct* const ScriptStruct = GetScriptStruct();
+
 		// Use faster path if the type matches.
-		if (const UScriptStruct* const BaseStructure = TBaseStructure<T>::Get(); ScriptStruct == BaseStructure)
+		if (const UScriptStruct* const BaseStructure = VariadicStruct::GetStaticStruct<T>(); ScriptStruct == BaseStructure)
 		{
 			return VariadicStruct::GetTypedPtr<const T>(GetTypeMemory<T>());
 		}
-		else if (!bExactType && ScriptStruct && ScriptStruct->IsChildOf(BaseStructure))
+		else if (!bExactType && IsChildOfType<T>())
 		{
 			return VariadicStruct::GetTypedPtr<const T>(GetMemory());
 		}
@@ -232,15 +615,17 @@ public: // Data Access
 	template<VariadicStruct::CSupportedType T, bool bExactType = false>
 	[[nodiscard]] const T& GetValue() const
 	{
+		const UScriptStruct* const ScriptStruct = GetScriptStruct();
+
 		// bExactType can be used to avoid branching and assert unexpected types.
-		if (bExactType || TBaseStructure<T>::Get() == ScriptStruct)
+		if (bExactType || VariadicStruct::GetStaticStruct<T>() == ScriptStruct)
 		{
-			checkf(!bExactType || TBaseStructure<T>::Get() == ScriptStruct, TEXT("FVariadicStruct: Exact type mismatch."));
+			checkf(!bExactType || VariadicStruct::GetStaticStruct<T>() == ScriptStruct, TEXT("FVariadicStruct: Exact type mismatch."));
 			return *VariadicStruct::GetTypedPtr<const T>(GetTypeMemory<T>());
 		}
 		else
 		{
-			checkf(ScriptStruct && ScriptStruct->IsChildOf(TBaseStructure<T>::Get()), TEXT("FVariadicStruct: Type mismatch."));
+			checkf(IsChildOfType<T>(), TEXT("FVariadicStruct: Type mismatch."));
 			return *VariadicStruct::GetTypedPtr<const T>(GetMemory());
 		}
 	}
@@ -249,12 +634,14 @@ public: // Data Access
 	template<VariadicStruct::CSupportedType T, bool bExactType = false>
 	[[nodiscard]] T* GetMutableValuePtr()
 	{
+		const UScriptStruct* const ScriptStruct = GetScriptStruct();
+
 		// Use faster path if the type matches.
-		if (const UScriptStruct* const BaseStructure = TBaseStructure<T>::Get(); ScriptStruct == BaseStructure)
+		if (const UScriptStruct* const BaseStructure = VariadicStruct::GetStaticStruct<T>(); ScriptStruct == BaseStructure)
 		{
 			return VariadicStruct::GetTypedPtr<T>(GetMutableTypeMemory<T>());
 		}
-		else if (!bExactType && ScriptStruct && ScriptStruct->IsChildOf(BaseStructure))
+		else if (!bExactType && IsChildOfType<T>())
 		{
 			return VariadicStruct::GetTypedPtr<T>(GetMutableMemory());
 		}
@@ -266,15 +653,17 @@ public: // Data Access
 	template<VariadicStruct::CSupportedType T, bool bExactType = false>
 	[[nodiscard]] T& GetMutableValue()
 	{
+		const UScriptStruct* const ScriptStruct = GetScriptStruct();
+
 		// bExactType can be used to avoid branching and assert unexpected types.
-		if (bExactType || TBaseStructure<T>::Get() == ScriptStruct)
+		if (bExactType || VariadicStruct::GetStaticStruct<T>() == ScriptStruct)
 		{
-			checkf(!bExactType || TBaseStructure<T>::Get() == ScriptStruct, TEXT("FVariadicStruct: Exact type mismatch."));
+			checkf(!bExactType || VariadicStruct::GetStaticStruct<T>() == ScriptStruct, TEXT("FVariadicStruct: Exact type mismatch."));
 			return *VariadicStruct::GetTypedPtr<T>(GetMutableTypeMemory<T>());
 		}
 		else
 		{
-			checkf(ScriptStruct && ScriptStruct->IsChildOf(TBaseStructure<T>::Get()), TEXT("FVariadicStruct: Type mismatch."));
+			checkf(IsChildOfType<T>(), TEXT("FVariadicStruct: Type mismatch."));
 			return *VariadicStruct::GetTypedPtr<T>(GetMutableMemory());
 		}
 	}
@@ -284,126 +673,632 @@ public: // Utility
 	/** Whether FVariadicStruct wraps any struct value. */
 	bool IsValid() const
 	{
-		return GetScriptStruct() != nullptr;
+		return TypeHandle.IsValid();
 	}
 
 	/** Returns UScriptStruct of the underlying struct. */
 	const UScriptStruct* GetScriptStruct() const
 	{
-		return ScriptStruct;
+		const VariadicStruct::FTypeInfo* const TypeInfo = GetTypeInfo();
+		return TypeInfo ? TypeInfo->ScriptStruct : nullptr;
+	}
+
+	/** Returns cached operations of the underlying struct type. */
+	const VariadicStruct::FTypeInfo* GetTypeInfo() const
+	{
+		return TypeHandle.GetTypeInfo();
 	}
 
 	/** Returns a const pointer to the underlying struct memory. */
 	const uint8* GetMemory() const
 	{
-		return ScriptStruct && !RequiresMemoryAllocation(ScriptStruct) ? StructBuffer : StructMemory;
+		// Mask-and-select without touching the type, the heap memory is nullptr if empty.
+		const UPTRINT InlineMask = TypeHandle.GetInlineMask();
+		return reinterpret_cast<const uint8*>((reinterpret_cast<UPTRINT>(StructBuffer) & InlineMask) | (reinterpret_cast<UPTRINT>(GetStructMemory()) & ~InlineMask));
 	}
 
 	/** Returns a mutable pointer to the underlying struct memory. */
 	uint8* GetMutableMemory()
 	{
-		return ScriptStruct && !RequiresMemoryAllocation(ScriptStruct) ? StructBuffer : StructMemory;
+		// Mask-and-select without touching the type, the heap memory is nullptr if empty.
+		const UPTRINT InlineMask = TypeHandle.GetInlineMask();
+		return reinterpret_cast<uint8*>((reinterpret_cast<UPTRINT>(StructBuffer) & InlineMask) | (reinterpret_cast<UPTRINT>(GetStructMemory()) & ~InlineMask));
 	}
 
 	/** Deep compares the struct instance when identical. */
-	bool operator==(const FVariadicStruct& Other) const
+	bool operator==(const TVariadicStruct& Other) const
 	{
 		return Identical(&Other, PPF_None);
 	}
 
 	/** Deep compares the struct instance when identical. */
-	bool operator!=(const FVariadicStruct& Other) const
+	bool operator!=(const TVariadicStruct& Other) const
 	{
 		return !Identical(&Other, PPF_None);
 	}
 
 	/** Destroy the underlying struct value. StructBuffer retains garbage. */
-	void Reset();
+	void Reset()
+	{
+		if (const VariadicStruct::FTypeInfo* const TypeInfo = GetTypeInfo())
+		{
+			if (IsInline())
+			{
+				TypeInfo->DestroyValue(StructBuffer);
+			}
+			else
+			{
+				uint8* const MemoryPtr = GetStructMemory();
+				TypeInfo->DestroyValue(MemoryPtr);
+				FreeHeapMemory(*TypeInfo, MemoryPtr);
+			}
+		}
+
+		ResetStructData();
+	}
+
+	/** Exchanges the values. Heap memory and trivially relocatable values are swapped bytewise, others are moved through a temporary. */
+	void Swap(TVariadicStruct& InOther)
+	{
+		if (this == &InOther)
+		{
+			return;
+		}
+
+		if (IsBitwiseRelocatable() && InOther.IsBitwiseRelocatable())
+		{
+			FMemory::Memswap(StructBuffer, InOther.StructBuffer, BUFFER_SIZE);
+			::Swap(TypeHandle, InOther.TypeHandle);
+		}
+		else
+		{
+			TVariadicStruct Temp(MoveTemp(InOther));
+			InOther = MoveTemp(*this);
+			*this = MoveTemp(Temp);
+		}
+	}
+
+	/** Picked by the algorithms over the generic Swap(), which goes through three moves. */
+	friend void Swap(FDerivedType& A, FDerivedType& B)
+	{
+		A.Swap(B);
+	}
+
+	/** Releases the heap memory exceeding the current type, which might be retained after re-initializing from a larger type. */
+	void Shrink()
+	{
+		const VariadicStruct::FTypeInfo* const TypeInfo = GetTypeInfo();
+
+		if (TypeInfo && !IsInline() && GetHeapCapacity() > static_cast<uint32>(TypeInfo->Size))
+		{
+			uint8* const MemoryPtr = GetStructMemory();
+			uint8* const NewMemoryPtr = static_cast<uint8*>(FAllocator::Malloc(TypeInfo->Size, FMath::Max<uint32>(TypeInfo->Alignment, MIN_HEAP_ALIGNMENT)));
+			checkSlow(NewMemoryPtr != nullptr);
+
+			TypeInfo->Relocate(*TypeInfo, NewMemoryPtr, MemoryPtr);
+			FreeHeapMemory(*TypeInfo, MemoryPtr);
+			SetHeapMemory(NewMemoryPtr, TypeInfo->Size);
+		}
+	}
+
+public: // Ranges
+
+	/** Initializes all values from UScriptStruct type and copies the value if needed. The type is resolved once for the whole range. */
+	static void InitializeRangeAs(TArrayView<FDerivedType> InValues, const UScriptStruct* InScriptStruct, const uint8* InStructMemory = nullptr)
+	{
+		checkf(VariadicStruct::ValidateScriptStruct(InScriptStruct), TEXT("FVariadicStruct: Trying to init with unsupported UScriptStruct."));
+
+		const VariadicStruct::FTypeInfo* const InTypeInfo = VariadicStruct::FindOrAddTypeInfo(InScriptStruct);
+
+		if (!InTypeInfo)
+		{
+			ResetRange(InValues);
+			return;
+		}
+
+		// Default initialization from the snapshot is the same copy construction.
+		const uint8* SourceMemory = InStructMemory;
+
+		if (!SourceMemory && InTypeInfo->HasAnyFlags(VariadicStruct::ETypeFlags::DefaultSnapshot))
+		{
+			SourceMemory = static_cast<const uint8*>(VariadicStruct::Private::GetDefaultSnapshot(*InTypeInfo));
+		}
+
+		if (!RequiresMemoryAllocation(*InTypeInfo))
+		{
+			ResetRange(InValues);
+
+			for (TVariadicStruct& Value : InValues)
+			{
+				Value.SetTypeInfo(InTypeInfo, true);
+
+				if (SourceMemory)
+				{
+					InTypeInfo->CopyConstruct(*InTypeInfo, Value.StructBuffer, SourceMemory);
+				}
+				else
+				{
+					Value.DefaultConstruct(*InTypeInfo, Value.StructBuffer);
+				}
+			}
+		}
+		else
+		{
+			for (TVariadicStruct& Value : InValues)
+			{
+				uint8* const MemoryPtr = Value.ReinitializeHeapMemory(InTypeInfo->Size, InTypeInfo->Alignment);
+				Value.SetTypeInfo(InTypeInfo, false);
+
+				if (SourceMemory)
+				{
+					InTypeInfo->CopyConstruct(*InTypeInfo, MemoryPtr, SourceMemory);
+				}
+				else
+				{
+					InTypeInfo->DefaultConstruct(MemoryPtr);
+				}
+			}
+		}
+	}
+
+	/** Resets all values. The destruction is skipped for the runs of the types without destructors. */
+	static void ResetRange(TArrayView<FDerivedType> InValues)
+	{
+		const VariadicStruct::FTypeInfo* LastTypeInfo = nullptr;
+		bool bRequiresDestroy = false;
+
+		for (TVariadicStruct& Value : InValues)
+		{
+			const VariadicStruct::FTypeInfo* const TypeInfo = Value.GetTypeInfo();
+
+			if (!TypeInfo)
+			{
+				continue;
+			}
+
+			if (TypeInfo != LastTypeInfo)
+			{
+				LastTypeInfo = TypeInfo;
+				bRequiresDestroy = !TypeInfo->HasAnyFlags(VariadicStruct::ETypeFlags::NoDestructor);
+			}
+
+			uint8* const MemoryPtr = Value.GetMutableMemory();
+
+			if (bRequiresDestroy)
+			{
+				TypeInfo->Destroy(*TypeInfo, MemoryPtr);
+			}
+
+			if (!Value.IsInline())
+			{
+				Value.FreeHeapMemory(*TypeInfo, MemoryPtr);
+			}
+
+			Value.ResetStructData();
+		}
+	}
+
+	/** Copies the values element-wise, plain old data within the buffer is copied along with the type without touching the reflection. */
+	static void CopyRange(TArrayView<FDerivedType> OutValues, TArrayView<const FDerivedType> InValues)
+	{
+		checkf(OutValues.Num() == InValues.Num(), TEXT("FVariadicStruct: Copying ranges of different sizes."));
+
+		for (int32 Index = 0; Index < InValues.Num(); ++Index)
+		{
+			TVariadicStruct& Value = OutValues[Index];
+			const TVariadicStruct& Other = InValues[Index];
+
+			if (&Value == &Other)
+			{
+				continue;
+			}
+
+			if (Other.IsInline() && Other.GetTypeInfo()->HasAnyFlags(VariadicStruct::ETypeFlags::PlainOldData))
+			{
+				Value.Reset();
+				FMemory::Memcpy(Value.StructBuffer, Other.StructBuffer, BUFFER_SIZE);
+				Value.TypeHandle = Other.TypeHandle;
+			}
+			else
+			{
+				Value.InitializeAsTypeInfo(Other.GetTypeInfo(), Other.GetMemory());
+			}
+		}
+	}
 
 public: // StructOpsTypeTraits
 
 	// Mostly copy pasted from FInstancedStruct.
-	bool Serialize(FArchive& Ar, const FConstStructView* Defaults = nullptr);
-	bool Identical(const FVariadicStruct* Other, uint32 PortFlags = PPF_None) const;
-	void AddStructReferencedObjects(FReferenceCollector& Collector);
-	bool ExportTextItem(FString& ValueStr, const FVariadicStruct& DefaultValue = FVariadicStruct(), UObject* Parent = nullptr, int32 PortFlags = PPF_None, UObject* ExportRootScope = nullptr) const;
-	bool ImportTextItem(const TCHAR*& Buffer, int32 PortFlags = PPF_None, UObject* Parent = nullptr, FOutputDevice* ErrorText = nullptr, FArchive* InSerializingArchive = nullptr);
-	bool SerializeFromMismatchedTag(const FPropertyTag& Tag, FStructuredArchive::FSlot Slot);
-	void GetPreloadDependencies(TArray<UObject*>& OutDeps);
-	bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess);
-	bool FindInnerPropertyInstance(FName PropertyName, const FProperty*& OutProp, const void*& OutData) const;
+
+	bool Serialize(FArchive& Ar, const FConstStructView* Defaults = nullptr)
+	{
+		return VariadicStruct::Private::Serialize(MakeRef(), Ar, Defaults);
+	}
+
+	bool Identical(const TVariadicStruct* Other, uint32 PortFlags = PPF_None) const
+	{
+		if (const UScriptStruct* const ScriptStruct = GetScriptStruct(); ScriptStruct && ScriptStruct == Other->GetScriptStruct())
+		{
+			return ScriptStruct->CompareScriptStruct(GetMemory(), Other->GetMemory(), PortFlags);
+		}
+
+		return false;
+	}
+
+	void AddStructReferencedObjects(FReferenceCollector& Collector)
+	{
+		VariadicStruct::Private::AddStructReferencedObjects(MakeRef(), Collector);
+	}
+
+	bool ExportTextItem(FString& ValueStr, const TVariadicStruct& DefaultValue = TVariadicStruct(), UObject* Parent = nullptr, int32 PortFlags = PPF_None, UObject* ExportRootScope = nullptr) const
+	{
+		return VariadicStruct::Private::ExportTextItem(MakeRef(), ValueStr, Parent, PortFlags, ExportRootScope);
+	}
+
+	bool ImportTextItem(const TCHAR*& Buffer, int32 PortFlags = PPF_None, UObject* Parent = nullptr, FOutputDevice* ErrorText = nullptr, FArchive* InSerializingArchive = nullptr)
+	{
+		return VariadicStruct::Private::ImportTextItem(MakeRef(), Buffer, PortFlags, Parent, ErrorText);
+	}
+
+	bool SerializeFromMismatchedTag(const FPropertyTag& Tag, FStructuredArchive::FSlot Slot)
+	{
+		return VariadicStruct::Private::SerializeFromMismatchedTag(MakeRef(), Tag, Slot);
+	}
+
+	void GetPreloadDependencies(TArray<UObject*>& OutDeps)
+	{
+		VariadicStruct::Private::GetPreloadDependencies(MakeRef(), OutDeps);
+	}
+
+	bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+	{
+		return VariadicStruct::Private::NetSerialize(MakeRef(), Ar, Map, bOutSuccess);
+	}
+
+	bool FindInnerPropertyInstance(FName PropertyName, const FProperty*& OutProp, const void*& OutData) const
+	{
+		return VariadicStruct::Private::FindInnerPropertyInstance(MakeRef(), PropertyName, OutProp, OutData);
+	}
+
 #if !UE_VERSION_OLDER_THAN(5, 5, 0)
-	EPropertyVisitorControlFlow Visit(FPropertyVisitorPath& Path, const FPropertyVisitorData& Data, const TFunctionRef<EPropertyVisitorControlFlow(const FPropertyVisitorPath& /*Path*/, const FPropertyVisitorData& /*Data*/)> InFunc) const;
-	void* ResolveVisitedPathInfo(const FPropertyVisitorInfo& Info) const;
+	EPropertyVisitorControlFlow Visit(FPropertyVisitorPath& Path, const FPropertyVisitorData& Data, const TFunctionRef<EPropertyVisitorControlFlow(const FPropertyVisitorPath& /*Path*/, const FPropertyVisitorData& /*Data*/)> InFunc) const
+	{
+		return VariadicStruct::Private::Visit(MakeRef(), Path, Data, InFunc);
+	}
+
+	void* ResolveVisitedPathInfo(const FPropertyVisitorInfo& Info) const
+	{
+		return VariadicStruct::Private::ResolveVisitedPathInfo(MakeRef(), Info);
+	}
 #endif // UE_VERSION_OLDER_THAN
 
 protected:
 
-	void ResetStructData(const UScriptStruct* InScriptStruct = nullptr, uint8* InStructMemory = nullptr)
+	void ResetStructData()
+	{
+		SetHeapMemory(nullptr, 0);
+		SetTypeInfo(nullptr, /* bInline */ false);
+	}
+
+	/** Tags the type with the storage mode, the heap memory is expected to be set if the value isn't inline. */
+	void SetTypeInfo(const VariadicStruct::FTypeInfo* InTypeInfo, bool bInline)
+	{
+		checkSlow(InTypeInfo || !bInline);
+		TypeHandle.SetTypeInfo(InTypeInfo, bInline);
+	}
+
+	/** Whether the value is stored in StructBuffer. */
+	bool IsInline() const
+	{
+		return TypeHandle.IsInline();
+	}
+
+	/** Returns the heap memory pointer stored at the beginning of StructBuffer. Garbage if the value is inline. */
+	uint8* GetStructMemory() const
+	{
+		uint8* Memory;
+		FMemory::Memcpy(&Memory, StructBuffer, sizeof(Memory));
+		return Memory;
+	}
+
+	/** Returns the size of the heap memory stored after the pointer. Garbage if the value is inline. */
+	uint32 GetHeapCapacity() const
 	{
-		// This will also formally make StructMemory active in union.
-		StructMemory = InStructMemory;
-		ScriptStruct = InScriptStruct;
+		uint32 Capacity;
+		FMemory::Memcpy(&Capacity, StructBuffer + sizeof(uint8*), sizeof(Capacity));
+		return Capacity;
+	}
+
+	/** Stores the heap memory pointer and its size at the beginning of StructBuffer. */
+	void SetHeapMemory(uint8* InStructMemory, uint32 InCapacity)
+	{
+		FMemory::Memcpy(StructBuffer, &InStructMemory, sizeof(InStructMemory));
+		FMemory::Memcpy(StructBuffer + sizeof(uint8*), &InCapacity, sizeof(InCapacity));
+	}
+
+	/** Initializes from the cached type operations and copies the value if needed. */
+	void InitializeAsTypeInfo(const VariadicStruct::FTypeInfo* InTypeInfo, const uint8* InStructMemory)
+	{
+		// If the existing type is valid and matches.
+		if (const VariadicStruct::FTypeInfo* const TypeInfo = GetTypeInfo(); TypeInfo && InTypeInfo && TypeInfo->ScriptStruct == InTypeInfo->ScriptStruct)
+		{
+			// Copy properties if needed.
+			if (InStructMemory)
+			{
+				TypeInfo->Copy(*TypeInfo, GetMutableMemory(), InStructMemory);
+			}
+			else if (TypeInfo->HasAnyFlags(VariadicStruct::ETypeFlags::DefaultSnapshot)) // Otherwise, reset to default state.
+			{
+				TypeInfo->Copy(*TypeInfo, GetMutableMemory(), VariadicStruct::Private::GetDefaultSnapshot(*TypeInfo));
+			}
+			else
+			{
+				uint8* const MemoryPtr = GetMutableMemory();
+				TypeInfo->DestroyValue(MemoryPtr);
+				DefaultConstruct(*TypeInfo, MemoryPtr);
+			}
+		}
+		else if (InTypeInfo) // Construct a new struct if needed.
+		{
+			uint8* MemoryPtr = StructBuffer;
+			const bool bInline = !RequiresMemoryAllocation(*InTypeInfo);
+
+			// Allocate a new space if the buffer is too small, or reuse the existing one if it fits.
+			if (bInline)
+			{
+				Reset();
+			}
+			else
+			{
+				MemoryPtr = ReinitializeHeapMemory(InTypeInfo->Size, InTypeInfo->Alignment);
+			}
+
+			SetTypeInfo(InTypeInfo, bInline);
+
+			// Copy construct in a single pass if needed.
+			if (InStructMemory)
+			{
+				InTypeInfo->CopyConstruct(*InTypeInfo, MemoryPtr, InStructMemory);
+			}
+			else // Otherwise, default initialize.
+			{
+				DefaultConstruct(*InTypeInfo, MemoryPtr);
+			}
+		}
+		else
+		{
+			Reset();
+		}
+	}
+
+	/**
+	 * Destroys the existing value and returns the heap memory for the new type.
+	 * The existing heap memory is reused if it fits, otherwise it's released and a new one is allocated.
+	 * The type needs to be set by the caller.
+	 */
+	uint8* ReinitializeHeapMemory(SIZE_T InSize, uint32 InAlignment)
+	{
+		if (const VariadicStruct::FTypeInfo* const TypeInfo = GetTypeInfo(); TypeInfo && !IsInline())
+		{
+			uint8* const MemoryPtr = GetStructMemory();
+			TypeInfo->DestroyValue(MemoryPtr);
+
+			// Over-aligned memory is never reused, so it's always released with the alignment of the current type.
+			if (InSize <= GetHeapCapacity() && FMath::Max<uint32>(TypeInfo->Alignment, InAlignment) <= MIN_HEAP_ALIGNMENT)
+			{
+				return MemoryPtr;
+			}
+
+			FreeHeapMemory(*TypeInfo, MemoryPtr);
+			ResetStructData();
+		}
+		else
+		{
+			Reset();
+		}
+
+		uint8* const MemoryPtr = static_cast<uint8*>(FAllocator::Malloc(InSize, FMath::Max<uint32>(InAlignment, MIN_HEAP_ALIGNMENT)));
+		checkSlow(MemoryPtr != nullptr);
+		SetHeapMemory(MemoryPtr, IntCastChecked<uint32>(InSize));
+		return MemoryPtr;
+	}
+
+	/**
+	 * Replaces the type keeping the value, which needs an identical layout, e.g. UDS reinstancing.
+	 * The value is moved between the buffer and the heap if the storage of the new type differs, e.g. it gained ForceHeap.
+	 */
+	void ReplaceTypeInfo(const VariadicStruct::FTypeInfo* InTypeInfo)
+	{
+		const VariadicStruct::FTypeInfo* const TypeInfo = GetTypeInfo();
+		checkf(TypeInfo && InTypeInfo && TypeInfo->Size == InTypeInfo->Size && TypeInfo->Alignment == InTypeInfo->Alignment, TEXT("FVariadicStruct: Replacing the type with a different layout."));
+
+		const bool bInline = !RequiresMemoryAllocation(*InTypeInfo);
+
+		if (bInline != IsInline())
+		{
+			if (bInline)
+			{
+				// The heap memory is tracked within the buffer, so the value is moved aside until the memory is released.
+				alignas(ALIGNMENT) uint8 TempBuffer[BUFFER_SIZE];
+				uint8* const MemoryPtr = GetStructMemory();
+				TypeInfo->Relocate(*TypeInfo, TempBuffer, MemoryPtr);
+				FreeHeapMemory(*TypeInfo, MemoryPtr);
+				TypeInfo->Relocate(*TypeInfo, StructBuffer, TempBuffer);
+			}
+			else
+			{
+				uint8* const MemoryPtr = static_cast<uint8*>(FAllocator::Malloc(TypeInfo->Size, FMath::Max<uint32>(TypeInfo->Alignment, MIN_HEAP_ALIGNMENT)));
+				TypeInfo->Relocate(*TypeInfo, MemoryPtr, StructBuffer);
+				SetHeapMemory(MemoryPtr, TypeInfo->Size);
+			}
+		}
+
+		SetTypeInfo(InTypeInfo, bInline);
+	}
+
+	/** Default constructs the value, zero constructible types within the buffer are zeroed at once with the fixed size. */
+	void DefaultConstruct(const VariadicStruct::FTypeInfo& InTypeInfo, uint8* MemoryPtr)
+	{
+		if (MemoryPtr == StructBuffer && InTypeInfo.HasAnyFlags(VariadicStruct::ETypeFlags::ZeroConstructor))
+		{
+			FMemory::Memzero(StructBuffer, BUFFER_SIZE);
+		}
+		else
+		{
+			InTypeInfo.DefaultConstruct(MemoryPtr);
+		}
+	}
+
+	/** Releases the heap memory of the current value, which needs to be destroyed beforehand. */
+	void FreeHeapMemory(const VariadicStruct::FTypeInfo& InTypeInfo, uint8* MemoryPtr)
+	{
+		if (IsExternalHeapMemory())
+		{
+			GetDeleter()(MemoryPtr);
+		}
+		else if constexpr (FAllocator::bRequiresFree) // Arena memory is released in bulk.
+		{
+			FAllocator::Free(MemoryPtr, GetHeapCapacity(), FMath::Max<uint32>(InTypeInfo.Alignment, MIN_HEAP_ALIGNMENT));
+		}
+	}
+
+	/** Whether the heap memory was passed to Adopt(). Garbage if the value is inline. */
+	bool IsExternalHeapMemory() const
+	{
+		if constexpr (SUPPORTS_ADOPTION)
+		{
+			return GetHeapCapacity() == 0;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	/** Returns the deleter of the adopted memory stored after the capacity. */
+	FDeleter GetDeleter() const
+	{
+		FDeleter Deleter = nullptr;
+
+		if constexpr (SUPPORTS_ADOPTION)
+		{
+			FMemory::Memcpy(&Deleter, StructBuffer + DELETER_OFFSET, sizeof(Deleter));
+		}
+
+		return Deleter;
 	}
 
 	/** Determines whether the type requires memory allocation. */
-	bool RequiresMemoryAllocation(const UScriptStruct* InScriptStruct) const
+	static bool RequiresMemoryAllocation(const VariadicStruct::FTypeInfo& InTypeInfo)
 	{
 		// We can skip the extra alignment check at runtime if the buffer is properly sized.
-		if constexpr (BUFFER_SIZE < alignof(FVariadicStruct) * 2)
+		if constexpr (BUFFER_SIZE < ALIGNMENT * 2)
 		{
-			return InScriptStruct->GetStructureSize() > BUFFER_SIZE;
+			return InTypeInfo.Size > BUFFER_SIZE || InTypeInfo.HasAnyFlags(VariadicStruct::ETypeFlags::ForceHeap);
 		}
 		else
 		{
-			return InScriptStruct->GetStructureSize() > BUFFER_SIZE || InScriptStruct->GetMinAlignment() > alignof(FVariadicStruct);
+			return InTypeInfo.RequiresMemoryAllocation(BUFFER_SIZE, ALIGNMENT);
 		}
 	}
 
-	/** Determines whether the type requires memory allocation at compile time. */
+	/** Whether the value can be moved with memcpy, heap memory is always relocated by taking ownership. Empty values are trivially relocatable. */
+	bool IsBitwiseRelocatable() const
+	{
+		return !IsInline() || GetTypeInfo()->HasAnyFlags(VariadicStruct::ETypeFlags::TriviallyRelocatable);
+	}
+
+	/** Takes over the value of another instance with memcpy leaving it empty. The value needs to be destroyed beforehand. */
+	void RelocateFrom(TVariadicStruct& InOther)
+	{
+		FMemory::Memcpy(StructBuffer, InOther.StructBuffer, BUFFER_SIZE);
+		TypeHandle = InOther.TypeHandle;
+		InOther.ResetStructData();
+	}
+
+	/** Whether the underlying type derives from the template type in constant time through the cached ancestors, without registering the native descriptor of T. */
+	template<VariadicStruct::CSupportedType T>
+	bool IsChildOfType() const
+	{
+		const VariadicStruct::FTypeInfo* const TypeInfo = GetTypeInfo();
+		return TypeInfo && TypeInfo->IsChildOf(VariadicStruct::GetStaticStruct<T>(), VariadicStruct::GetStaticStructDepth<T>());
+	}
+
+	/** Determines whether the type requires memory allocation at compile time, considering VariadicStruct::TStorageHint. */
 	template<VariadicStruct::CSupportedType T>
 	static consteval bool TypeRequiresMemoryAllocation()
 	{
-		return sizeof(T) > BUFFER_SIZE || alignof(T) > alignof(FVariadicStruct);
+		constexpr bool bFits = sizeof(T) <= BUFFER_SIZE && alignof(T) <= ALIGNMENT;
+		static_assert(bFits || VariadicStruct::TStorageHint<T>::value != VariadicStruct::EStorageHint::Inline, "TVariadicStruct: The type is required to be stored inline, but doesn't fit into the buffer.");
+		return !bFits || IsForcedToHeap<T>();
 	}
 
-	/** Returns resolved memory location at compile time. */
+	/** Whether the type fitting into the buffer is forced to the heap with VariadicStruct::TStorageHint. */
+	template<VariadicStruct::CSupportedType T>
+	static consteval bool IsForcedToHeap()
+	{
+		return VariadicStruct::TStorageHint<T>::value == VariadicStruct::EStorageHint::Heap;
+	}
+
+	/** Returns resolved memory location at compile time. Types forced to the heap are resolved at runtime, as the reflection doesn't know the hint. */
 	template<VariadicStruct::CSupportedType T>
 	const uint8* GetTypeMemory() const
 	{
-		return TypeRequiresMemoryAllocation<T>() ? StructMemory : StructBuffer;
+		if constexpr (IsForcedToHeap<T>())
+		{
+			return GetMemory();
+		}
+		else
+		{
+			return TypeRequiresMemoryAllocation<T>() ? GetStructMemory() : StructBuffer;
+		}
 	}
 
-	/** Returns resolved memory location at compile time. */
+	/** Returns resolved memory location at compile time. Types forced to the heap are resolved at runtime, as the reflection doesn't know the hint. */
 	template<VariadicStruct::CSupportedType T>
 	uint8* GetMutableTypeMemory()
 	{
-		return TypeRequiresMemoryAllocation<T>() ? StructMemory : StructBuffer;
+		if constexpr (IsForcedToHeap<T>())
+		{
+			return GetMutableMemory();
+		}
+		else
+		{
+			return TypeRequiresMemoryAllocation<T>() ? GetStructMemory() : StructBuffer;
+		}
 	}
 
-private:
+	/** Returns a type-erased reference used by the shared out-of-line implementation. */
+	VariadicStruct::Private::FVariadicRef MakeRef() const
+	{
+		using FVariadicRef = VariadicStruct::Private::FVariadicRef;
 
-	/** Defined in .cpp to statically validate invariants. */
-	friend consteval void FVariadicStructValidateInvariants();
-	friend consteval void FVariadicStructValidateTestInvariants();
+		static constexpr FVariadicRef::FOps Ops =
+		{
+			[](const void* Variadic) -> const UScriptStruct* { return static_cast<const TVariadicStruct*>(Variadic)->GetScriptStruct(); },
+			[](void* Variadic) -> uint8* { return static_cast<TVariadicStruct*>(Variadic)->GetMutableMemory(); },
+			[](void* Variadic, const UScriptStruct* InScriptStruct, const uint8* InStructMemory) { static_cast<TVariadicStruct*>(Variadic)->InitializeAs(InScriptStruct, InStructMemory); },
+			[](void* Variadic, const UScriptStruct* InScriptStruct) { static_cast<TVariadicStruct*>(Variadic)->ReplaceTypeInfo(VariadicStruct::FindOrAddTypeInfo(InScriptStruct)); },
+		};
 
-	static inline constexpr int32 BUFFER_SIZE = 24;
+		return FVariadicRef{ const_cast<TVariadicStruct*>(this), &Ops };
+	}
 
-	union
-	{
-		/** Pointer to the heap for large structs. */
-		uint8* StructMemory = nullptr;
+private:
 
-		/** Inline memory buffer for small structs. */
-		uint8 StructBuffer[BUFFER_SIZE];
-	};
+	/** Offset of the adopted memory deleter within StructBuffer. */
+	static inline constexpr SIZE_T DELETER_OFFSET = sizeof(uint8*) + sizeof(uint32);
+
+	/** Inline memory buffer for small structs, or the pointer to the heap for large structs. */
+	uint8 StructBuffer[BUFFER_SIZE];
 
-	/** UScriptStruct type of the underlying struct value. */
-	TObjectPtr<const UScriptStruct> ScriptStruct = nullptr;
+	/** Cached operations of the underlying struct type tagged with the storage mode, the type itself is reported to GC by AddStructReferencedObjects. */
+	InTypeHandle TypeHandle;
 };
 
-template<>
-struct TStructOpsTypeTraits<FVariadicStruct> : public TStructOpsTypeTraitsBase2<FVariadicStruct>
+/** Shared StructOpsTypeTraits for reflected TVariadicStruct layouts. */
+template<typename T>
+struct TVariadicStructOpsTypeTraits : public TStructOpsTypeTraitsBase2<T>
 {
 	enum
 	{
@@ -423,7 +1318,121 @@ struct TStructOpsTypeTraits<FVariadicStruct> : public TStructOpsTypeTraitsBase2<
 	};
 };
 
+/**
+ * Reflected TVariadicStruct with default buffer size of 24 bytes and 16-byte alignment (32 bytes in total).
+ * @Note: UHT doesn't support template base types, so the base is hidden from it.
+ */
+USTRUCT()
+struct VARIADICSTRUCT_API FVariadicStruct
+#if CPP
+	: public TVariadicStruct<24, 16, FVariadicStruct>
+#endif // CPP
+{
+	GENERATED_BODY()
+};
+
+template<>
+struct TStructOpsTypeTraits<FVariadicStruct> : public TVariadicStructOpsTypeTraits<FVariadicStruct>
+{
+};
+
+/**
+ * Reflected TVariadicStruct with buffer size of 12 bytes and 8-byte alignment (16 bytes in total), same as FInstancedStruct.
+ * The type is stored as a 32-bit index into the global type registry, which costs an extra indirection on the typed access.
+ * Particularly useful for large arrays of optional payloads which are mostly empty or fit into 12 bytes.
+ * @Note: UHT doesn't support template base types, so the base is hidden from it.
+ */
+USTRUCT()
+struct VARIADICSTRUCT_API FCompactVariadicStruct
+#if CPP
+	: public TVariadicStruct<12, 8, FCompactVariadicStruct, VariadicStruct::FTypeIndexHandle>
+#endif // CPP
+{
+	GENERATED_BODY()
+};
+
+template<>
+struct TStructOpsTypeTraits<FCompactVariadicStruct> : public TVariadicStructOpsTypeTraits<FCompactVariadicStruct>
+{
+};
+
+/**
+ * Reflected TVariadicStruct with buffer size of 24 bytes and 8-byte alignment (32 bytes in total).
+ * Doesn't impose 16-byte alignment on the embedding structs, 16-byte aligned types, e.g. FQuat, are allocated on the heap instead.
+ * @Note: UHT doesn't support template base types, so the base is hidden from it.
+ */
+USTRUCT()
+struct VARIADICSTRUCT_API FPackedVariadicStruct
+#if CPP
+	: public TVariadicStruct<24, 8, FPackedVariadicStruct>
+#endif // CPP
+{
+	GENERATED_BODY()
+};
+
+template<>
+struct TStructOpsTypeTraits<FPackedVariadicStruct> : public TVariadicStructOpsTypeTraits<FPackedVariadicStruct>
+{
+};
+
 inline bool VariadicStruct::ValidateScriptStruct(const UScriptStruct* InScriptStruct)
 {
 	return !InScriptStruct || [=]<typename... Args>(TypePack<Args...>) { return (... && (TBaseStructure<Args>::Get() != InScriptStruct)); }(UnsupportedTypes());
 }
+
+namespace VariadicStruct
+{
+	/** Outcome of MoveFromInstancedStructs(). */
+	struct FMigrationStats
+	{
+		/** Values relocated into the inline buffer. */
+		int32 NumInline = 0;
+
+		/** Values stored on the heap, including the adopted ones. */
+		int32 NumHeap = 0;
+
+		/** Values which took over the heap memory of FInstancedStruct without copying. */
+		int32 NumAdopted = 0;
+
+		/** Empty FInstancedStruct. */
+		int32 NumEmpty = 0;
+	};
+
+	/**
+	 * Appends the values of FInstancedStruct array to TVariadicStruct array in bulk and empties the source.
+	 * Small types are relocated into the inline buffer, the heap memory of large types is adopted where possible.
+	 */
+	template<typename TVariadic, typename TSourceAllocator, typename TDestAllocator>
+	FMigrationStats MoveFromInstancedStructs(TArray<FInstancedStruct, TSourceAllocator>& InSource, TArray<TVariadic, TDestAllocator>& OutDest)
+	{
+		FMigrationStats Stats;
+
+		OutDest.Reserve(OutDest.Num() + InSource.Num());
+
+		for (FInstancedStruct& InstancedStruct : InSource)
+		{
+			const uint8* const SourceMemory = InstancedStruct.GetMemory();
+			TVariadic& Variadic = OutDest.Emplace_GetRef();
+			Variadic.InitializeAs(MoveTemp(InstancedStruct));
+
+			if (!Variadic.IsValid())
+			{
+				++Stats.NumEmpty;
+			}
+			else if (Variadic.GetMemory() == reinterpret_cast<const uint8*>(&Variadic))
+			{
+				++Stats.NumInline;
+			}
+			else
+			{
+				++Stats.NumHeap;
+				Stats.NumAdopted += Variadic.GetMemory() == SourceMemory;
+			}
+		}
+
+		// The elements are empty at this point, release the array memory right away.
+		InSource.Empty();
+
+		return Stats;
+	}
+}
@@ -0,0 +1,53 @@
+// Copyright 2024 Ivan Baktenkov. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "Misc/MemStack.h"
+#include "VariadicStructPool.h"
+
+/**
+ * Allocator policies for the payloads which don't fit into the inline buffer of TVariadicStruct.
+ * A policy provides static Malloc(Size, Alignment) and Free(Ptr, Size, Alignment), and bRequiresFree to skip the latter.
+ */
+namespace VariadicStruct
+{
+	/** Global heap, routed through the payload pool if it is enabled. */
+	struct FHeapAllocator
+	{
+		static inline constexpr bool bRequiresFree = true;
+
+		static void* Malloc(SIZE_T Size, uint32 Alignment)
+		{
+			return Pool::Malloc(Size, Alignment);
+		}
+
+		static void Free(void* Ptr, SIZE_T Size, uint32 Alignment)
+		{
+			Pool::Free(Ptr, Size, Alignment);
+		}
+	};
+
+	/**
+	 * Bump allocation from an arena, which is released in bulk, so Reset() only destroys the value.
+	 * TArena needs to provide static Get() returning the current arena with Alloc(Size, Alignment), e.g. FMemStack.
+	 * @Note: The values need to be destroyed before the arena memory is released, e.g. before FMemMark goes out of scope.
+	 */
+	template<typename TArena>
+	struct TArenaAllocator
+	{
+		static inline constexpr bool bRequiresFree = false;
+
+		static void* Malloc(SIZE_T Size, uint32 Alignment)
+		{
+			return TArena::Get().Alloc(Size, Alignment);
+		}
+
+		static void Free(void* Ptr, SIZE_T Size, uint32 Alignment)
+		{
+		}
+	};
+
+	/** Frame allocation from the thread-local FMemStack. */
+	using FMemStackAllocator = TArenaAllocator<FMemStack>;
+}
@@ -0,0 +1,291 @@
+// Copyright 2024 Ivan Baktenkov. All Rights Reserved.
+
+#pragma once
+
+#include "CoreGlobals.h"
+#include "CoreTypes.h"
+#include "Logging/LogMacros.h"
+#include "Misc/AssertionMacros.h"
+#include "UObject/Class.h"
+#include "UObject/PropertyPortFlags.h"
+#include "VariadicStruct.h"
+
+#include <concepts>
+
+/**
+ * TVariadicStruct restricted to the types deriving from TBase, e.g. any child of FMyPayloadBase.
+ * The constraint is enforced on initialization, so GetBase() is an unchecked and branch-free reinterpretation of the memory.
+ * The base pointer is the value pointer, no offset is stored. The types placing TBase at a non-zero offset are rejected:
+ * - Native types are checked on InitializeAs<T>(), the offset is a constant folded by the compiler, as it can't be a static_assert.
+ * - Script types share the FProperty offsets of their reflected super, so TBase is at offset zero by construction of the reflection.
+ *   The native types behind them, e.g. the ones with a polymorphic non-reflected first base, are checked once they are initialized natively.
+ * Retains the StructOpsTypeTraits of the underlying layout, the loaded types not deriving from TBase are reset.
+ *
+ * Exposing to the reflection follows FVariadicStruct:
+ *
+ * USTRUCT()
+ * struct FMyPayloadVariadic
+ * #if CPP
+ *	: public TVariadicStructBase<FMyPayloadBase, FMyPayloadVariadic>
+ * #endif // CPP
+ * {
+ *	GENERATED_BODY()
+ * };
+ *
+ * template<>
+ * struct TStructOpsTypeTraits<FMyPayloadVariadic> : public TVariadicStructOpsTypeTraits<FMyPayloadVariadic> {};
+ *
+ * @param TBase - Base type of the stored values.
+ * @param InDerivedType - Optional type deriving from TVariadicStructBase which is returned by the factories.
+ * @param InVariadic - Underlying TVariadicStruct layout.
+ */
+template<VariadicStruct::CSupportedType TBase, typename InDerivedType = void, typename InVariadic = FVariadicStruct>
+struct TVariadicStructBase
+{
+public:
+
+	/** Type constructed by the factories. */
+	using FDerivedType = std::conditional_t<std::is_void_v<InDerivedType>, TVariadicStructBase, InDerivedType>;
+
+	/** Underlying layout. */
+	using FVariadic = InVariadic;
+
+	TVariadicStructBase() = default;
+
+	/** Initializes from struct template type deriving from TBase and optional params in place. */
+	template<VariadicStruct::CSupportedType T, typename... TArgs> requires(std::derived_from<T, TBase>)
+	T* InitializeAs(TArgs&&... InArgs)
+	{
+		checkf(GetBaseOffset<T>() == 0, TEXT("TVariadicStructBase: %s places %s at a non-zero offset."), *GetNameSafe(VariadicStruct::GetStaticStruct<T>()), *GetNameSafe(VariadicStruct::GetStaticStruct<TBase>()));
+		return Variadic.template InitializeAs<T>(Forward<TArgs>(InArgs)...);
+	}
+
+	/** Initializes from UScriptStruct type deriving from TBase and copies the value if needed. Resets the value if the type doesn't derive from TBase. */
+	void InitializeAs(const UScriptStruct* InScriptStruct, const uint8* InStructMemory = nullptr)
+	{
+		if (IsBaseOf(InScriptStruct))
+		{
+			Variadic.InitializeAs(InScriptStruct, InStructMemory);
+		}
+		else
+		{
+			ensureMsgf(false, TEXT("TVariadicStructBase: %s doesn't derive from %s."), *GetNameSafe(InScriptStruct), *GetNameSafe(VariadicStruct::GetStaticStruct<TBase>()));
+			Variadic.Reset();
+		}
+	}
+
+	/** Copy/move constructs a new value from a template struct deriving from TBase. */
+	template<typename T> requires(VariadicStruct::CSupportedType<std::remove_cvref_t<T>> && std::derived_from<std::remove_cvref_t<T>, TBase>)
+	[[nodiscard]] static FDerivedType Make(T&& InStruct)
+	{
+		FDerivedType Variadic;
+		Variadic.template InitializeAs<std::remove_cvref_t<T>>(Forward<T>(InStruct));
+		return Variadic;
+	}
+
+	/** Emplace constructs a new value from a template struct type deriving from TBase and arguments. */
+	template<VariadicStruct::CSupportedType T, typename... TArgs> requires(std::derived_from<T, TBase>)
+	[[nodiscard]] static FDerivedType Make(TArgs&&... InArgs)
+	{
+		FDerivedType Variadic;
+		Variadic.template InitializeAs<T>(Forward<TArgs>(InArgs)...);
+		return Variadic;
+	}
+
+	/** Default constructs a new value from UScriptStruct deriving from TBase and copies the value if needed. */
+	[[nodiscard]] static FDerivedType Make(const UScriptStruct* InScriptStruct, const uint8* InStructMemory = nullptr)
+	{
+		FDerivedType Variadic;
+		Variadic.InitializeAs(InScriptStruct, InStructMemory);
+		return Variadic;
+	}
+
+public: // Data Access
+
+	/** Returns a const pointer to the base of the value without the type check, or nullptr if empty. */
+	[[nodiscard]] const TBase* GetBase() const
+	{
+		return reinterpret_cast<const TBase*>(Variadic.GetMemory());
+	}
+
+	/** Returns a mutable pointer to the base of the value without the type check, or nullptr if empty. */
+	[[nodiscard]] TBase* GetMutableBase()
+	{
+		return reinterpret_cast<TBase*>(Variadic.GetMutableMemory());
+	}
+
+	/** Helper for validating the underlying type. */
+	template<VariadicStruct::CSupportedType T, bool bExactType = false>
+	[[nodiscard]] bool IsTypeOf() const
+	{
+		return Variadic.template IsTypeOf<T, bExactType>();
+	}
+
+	/** Returns a const pointer to the struct value, or nullptr if the type doesn't match. */
+	template<VariadicStruct::CSupportedType T, bool bExactType = false>
+	[[nodiscard]] const T* GetValuePtr() const
+	{
+		return Variadic.template GetValuePtr<T, bExactType>();
+	}
+
+	/** Returns a mutable pointer to the struct value, or nullptr if the type doesn't match. */
+	template<VariadicStruct::CSupportedType T, bool bExactType = false>
+	[[nodiscard]] T* GetMutableValuePtr()
+	{
+		return Variadic.template GetMutableValuePtr<T, bExactType>();
+	}
+
+	/** Returns a const reference to the struct value, or asserts if the type doesn't match. */
+	template<VariadicStruct::CSupportedType T, bool bExactType = false>
+	[[nodiscard]] const T& GetValue() const
+	{
+		return Variadic.template GetValue<T, bExactType>();
+	}
+
+	/** Returns a mutable reference to the struct value, or asserts if the type doesn't match. */
+	template<VariadicStruct::CSupportedType T, bool bExactType = false>
+	[[nodiscard]] T& GetMutableValue()
+	{
+		return Variadic.template GetMutableValue<T, bExactType>();
+	}
+
+public: // Utility
+
+	bool IsValid() const
+	{
+		return Variadic.IsValid();
+	}
+
+	const UScriptStruct* GetScriptStruct() const
+	{
+		return Variadic.GetScriptStruct();
+	}
+
+	const uint8* GetMemory() const
+	{
+		return Variadic.GetMemory();
+	}
+
+	uint8* GetMutableMemory()
+	{
+		return Variadic.GetMutableMemory();
+	}
+
+	/** Returns the underlying layout, which can't be mutated directly to keep the constraint. */
+	const FVariadic& GetVariadic() const
+	{
+		return Variadic;
+	}
+
+	bool operator==(const TVariadicStructBase& Other) const
+	{
+		return Variadic == Other.Variadic;
+	}
+
+	bool operator!=(const TVariadicStructBase& Other) const
+	{
+		return Variadic != Other.Variadic;
+	}
+
+	void Reset()
+	{
+		Variadic.Reset();
+	}
+
+	/** Whether the type derives from TBase, empty is allowed. */
+	static bool IsBaseOf(const UScriptStruct* InScriptStruct)
+	{
+		return !InScriptStruct || InScriptStruct->IsChildOf(VariadicStruct::GetStaticStruct<TBase>());
+	}
+
+public: // StructOpsTypeTraits
+
+	bool Serialize(FArchive& Ar, const FConstStructView* Defaults = nullptr)
+	{
+		const bool bResult = Variadic.Serialize(Ar, Defaults);
+		ValidateLoaded();
+		return bResult;
+	}
+
+	bool Identical(const TVariadicStructBase* Other, uint32 PortFlags = PPF_None) const
+	{
+		return Variadic.Identical(&Other->Variadic, PortFlags);
+	}
+
+	void AddStructReferencedObjects(FReferenceCollector& Collector)
+	{
+		Variadic.AddStructReferencedObjects(Collector);
+	}
+
+	bool ExportTextItem(FString& ValueStr, const TVariadicStructBase& DefaultValue = TVariadicStructBase(), UObject* Parent = nullptr, int32 PortFlags = PPF_None, UObject* ExportRootScope = nullptr) const
+	{
+		return Variadic.ExportTextItem(ValueStr, DefaultValue.Variadic, Parent, PortFlags, ExportRootScope);
+	}
+
+	bool ImportTextItem(const TCHAR*& Buffer, int32 PortFlags = PPF_None, UObject* Parent = nullptr, FOutputDevice* ErrorText = nullptr, FArchive* InSerializingArchive = nullptr)
+	{
+		const bool bResult = Variadic.ImportTextItem(Buffer, PortFlags, Parent, ErrorText, InSerializingArchive);
+		ValidateLoaded();
+		return bResult;
+	}
+
+	bool SerializeFromMismatchedTag(const FPropertyTag& Tag, FStructuredArchive::FSlot Slot)
+	{
+		const bool bResult = Variadic.SerializeFromMismatchedTag(Tag, Slot);
+		ValidateLoaded();
+		return bResult;
+	}
+
+	void GetPreloadDependencies(TArray<UObject*>& OutDeps)
+	{
+		Variadic.GetPreloadDependencies(OutDeps);
+	}
+
+	bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+	{
+		const bool bResult = Variadic.NetSerialize(Ar, Map, bOutSuccess);
+		ValidateLoaded();
+		return bResult;
+	}
+
+	bool FindInnerPropertyInstance(FName PropertyName, const FProperty*& OutProp, const void*& OutData) const
+	{
+		return Variadic.FindInnerPropertyInstance(PropertyName, OutProp, OutData);
+	}
+
+#if !UE_VERSION_OLDER_THAN(5, 5, 0)
+	EPropertyVisitorControlFlow Visit(FPropertyVisitorPath& Path, const FPropertyVisitorData& Data, const TFunctionRef<EPropertyVisitorControlFlow(const FPropertyVisitorPath& /*Path*/, const FPropertyVisitorData& /*Data*/)> InFunc) const
+	{
+		return Variadic.Visit(Path, Data, InFunc);
+	}
+
+	void* ResolveVisitedPathInfo(const FPropertyVisitorInfo& Info) const
+	{
+		return Variadic.ResolveVisitedPathInfo(Info);
+	}
+#endif // UE_VERSION_OLDER_THAN
+
+private:
+
+	/** Offset of the TBase subobject within T, folded to a constant. */
+	template<typename T>
+	static UPTRINT GetBaseOffset()
+	{
+		// Any suitably aligned non-null address, the pointer is never dereferenced.
+		constexpr UPTRINT Address = 0x1000;
+		return reinterpret_cast<UPTRINT>(static_cast<const TBase*>(reinterpret_cast<const T*>(Address))) - Address;
+	}
+
+	/** Resets the loaded value if its type doesn't derive from TBase, e.g. the base of a user defined struct was changed. */
+	void ValidateLoaded()
+	{
+		if (!IsBaseOf(Variadic.GetScriptStruct()))
+		{
+			UE_LOG(LogSerialization, Warning, TEXT("TVariadicStructBase: Loaded %s doesn't derive from %s, the value is reset."), *GetNameSafe(Variadic.GetScriptStruct()), *GetNameSafe(VariadicStruct::GetStaticStruct<TBase>()));
+			Variadic.Reset();
+		}
+	}
+
+	/** Underlying value, only initialized with the types deriving from TBase. */
+	FVariadic Variadic;
+};
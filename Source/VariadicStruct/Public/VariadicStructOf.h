@@ -0,0 +1,406 @@
+// Copyright 2024 Ivan Baktenkov. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "HAL/UnrealMemory.h"
+#include "UObject/Class.h"
+#include "UObject/PropertyPortFlags.h"
+#include "VariadicStruct.h"
+
+#include <algorithm> // std::max
+#include <concepts>
+#include <memory> // std::destroy_at
+
+/**
+ * Closed-set variant of TVariadicStruct holding one of the listed USTRUCT types or nothing.
+ * The buffer is sized to the largest type, so the value is always inline, and the type is stored as a small index.
+ * Copy, move and destroy are dispatched through compile-time tables without touching the reflection,
+ * subtype checks are resolved against a compile-time mask of the types deriving from the requested one.
+ * Serialization compatible with TVariadicStruct and FInstancedStruct, the types outside of the set are skipped on load.
+ */
+template<typename... Ts>
+struct TVariadicStructOf
+{
+	static_assert(sizeof...(Ts) > 0 && sizeof...(Ts) <= 64, "TVariadicStructOf: Supports from 1 to 64 types.");
+	static_assert((VariadicStruct::CSupportedType<Ts> && ...), "TVariadicStructOf: Unsupported type.");
+
+public:
+
+	/** Listed types. */
+	using FTypes = VariadicStruct::TypePack<Ts...>;
+
+	/** Number of the listed types. */
+	static inline constexpr int32 NUM_TYPES = sizeof...(Ts);
+
+	/** Size of the inline buffer, the largest of the types. */
+	static inline constexpr int32 BUFFER_SIZE = std::max({ static_cast<int32>(sizeof(Ts))... });
+
+	/** Alignment of the inline buffer, the largest of the types. */
+	static inline constexpr int32 ALIGNMENT = std::max({ static_cast<int32>(alignof(Ts))... });
+
+	/** Returns the index of the type within the set, or INDEX_NONE. */
+	template<typename T>
+	static consteval int32 IndexOf()
+	{
+		int32 Index = INDEX_NONE;
+		int32 Current = 0;
+		((Index = Index == INDEX_NONE && std::is_same_v<T, Ts> ? Current : Index, ++Current), ...);
+		return Index;
+	}
+
+	TVariadicStructOf() = default;
+
+	TVariadicStructOf(const TVariadicStructOf& InOther)
+	{
+		CopyFrom(InOther);
+	}
+
+	TVariadicStructOf(TVariadicStructOf&& InOther)
+	{
+		MoveFrom(InOther);
+	}
+
+	TVariadicStructOf& operator=(const TVariadicStructOf& InOther)
+	{
+		if (this != &InOther)
+		{
+			if (TypeIndex == InOther.TypeIndex && TypeIndex != 0)
+			{
+				CopyTable[TypeIndex - 1](StructBuffer, InOther.StructBuffer);
+			}
+			else
+			{
+				Reset();
+				CopyFrom(InOther);
+			}
+		}
+
+		return *this;
+	}
+
+	TVariadicStructOf& operator=(TVariadicStructOf&& InOther)
+	{
+		if (this != &InOther)
+		{
+			Reset();
+			MoveFrom(InOther);
+		}
+
+		return *this;
+	}
+
+	~TVariadicStructOf()
+	{
+		Reset();
+	}
+
+	/** Initializes from struct template type and optional params in place. */
+	template<typename T, typename... TArgs>
+	T& InitializeAs(TArgs&&... InArgs)
+	{
+		static_assert(IndexOf<T>() != INDEX_NONE, "TVariadicStructOf: The type isn't in the set.");
+
+		Reset();
+		T* const Value = new (StructBuffer) T(Forward<TArgs>(InArgs)...);
+		TypeIndex = IndexOf<T>() + 1;
+		return *Value;
+	}
+
+	/**
+	 * Initializes from UScriptStruct type and copies the value if needed. Resets the value if the type isn't in the set, so the loader skips it.
+	 * The source memory may point into the current value, e.g. a member of it.
+	 */
+	void InitializeAs(const UScriptStruct* InScriptStruct, const uint8* InStructMemory = nullptr)
+	{
+		const int32 Index = FindIndex(InScriptStruct);
+
+		if (Index == INDEX_NONE)
+		{
+			Reset();
+			return;
+		}
+
+		if (!InStructMemory)
+		{
+			Reset();
+			DefaultConstructTable[Index](StructBuffer);
+		}
+		else if (TypeIndex == Index + 1)
+		{
+			// Same type, copy assigned in place.
+			if (InStructMemory != StructBuffer)
+			{
+				CopyTable[Index](StructBuffer, InStructMemory);
+			}
+		}
+		else if (InStructMemory >= StructBuffer && InStructMemory < StructBuffer + BUFFER_SIZE)
+		{
+			// The source lives within the current value, so it's copied aside before the value is destroyed.
+			alignas(ALIGNMENT) uint8 TempBuffer[BUFFER_SIZE];
+			CopyConstructTable[Index](TempBuffer, InStructMemory);
+			Reset();
+			MoveConstructTable[Index](StructBuffer, TempBuffer);
+			DestroyTable[Index](TempBuffer);
+		}
+		else
+		{
+			Reset();
+			CopyConstructTable[Index](StructBuffer, InStructMemory);
+		}
+
+		TypeIndex = static_cast<uint8>(Index + 1);
+	}
+
+	/** Copy/move constructs a new value from a template struct. */
+	template<typename T> requires(IndexOf<std::remove_cvref_t<T>>() != INDEX_NONE)
+	[[nodiscard]] static TVariadicStructOf Make(T&& InStruct)
+	{
+		TVariadicStructOf Variadic;
+		Variadic.template InitializeAs<std::remove_cvref_t<T>>(Forward<T>(InStruct));
+		return Variadic;
+	}
+
+	/** Emplace constructs a new value from a template struct type and arguments. */
+	template<typename T, typename... TArgs>
+	[[nodiscard]] static TVariadicStructOf Make(TArgs&&... InArgs)
+	{
+		TVariadicStructOf Variadic;
+		Variadic.template InitializeAs<T>(Forward<TArgs>(InArgs)...);
+		return Variadic;
+	}
+
+public: // Data Access
+
+	/** Whether the underlying type is the template type or derives from it. Resolved with a compile-time mask. */
+	template<VariadicStruct::CSupportedType T, bool bExactType = false>
+	[[nodiscard]] bool IsTypeOf() const
+	{
+		if constexpr (bExactType)
+		{
+			// The types outside of the set never match, including the empty value.
+			return IndexOf<T>() != INDEX_NONE && TypeIndex == IndexOf<T>() + 1;
+		}
+		else
+		{
+			return TypeIndex != 0 && (ChildMask<T>() >> (TypeIndex - 1) & 1) != 0;
+		}
+	}
+
+	/** Returns a const pointer to the struct value, or nullptr if the type doesn't match. */
+	template<VariadicStruct::CSupportedType T, bool bExactType = false>
+	[[nodiscard]] const T* GetValuePtr() const
+	{
+		return IsTypeOf<T, bExactType>() ? VariadicStruct::GetTypedPtr<const T>(StructBuffer) : nullptr;
+	}
+
+	/** Returns a mutable pointer to the struct value, or nullptr if the type doesn't match. */
+	template<VariadicStruct::CSupportedType T, bool bExactType = false>
+	[[nodiscard]] T* GetMutableValuePtr()
+	{
+		return IsTypeOf<T, bExactType>() ? VariadicStruct::GetTypedPtr<T>(StructBuffer) : nullptr;
+	}
+
+	/** Returns a const reference to the struct value, or asserts if the type doesn't match. */
+	template<VariadicStruct::CSupportedType T, bool bExactType = false>
+	[[nodiscard]] const T& GetValue() const
+	{
+		checkf((IsTypeOf<T, bExactType>()), TEXT("TVariadicStructOf: Type mismatch."));
+		return *VariadicStruct::GetTypedPtr<const T>(StructBuffer);
+	}
+
+	/** Returns a mutable reference to the struct value, or asserts if the type doesn't match. */
+	template<VariadicStruct::CSupportedType T, bool bExactType = false>
+	[[nodiscard]] T& GetMutableValue()
+	{
+		checkf((IsTypeOf<T, bExactType>()), TEXT("TVariadicStructOf: Type mismatch."));
+		return *VariadicStruct::GetTypedPtr<T>(StructBuffer);
+	}
+
+public: // Utility
+
+	/** Whether any struct value is stored. */
+	bool IsValid() const
+	{
+		return TypeIndex != 0;
+	}
+
+	/** Returns the index of the underlying type within the set, or INDEX_NONE. */
+	int32 GetTypeIndex() const
+	{
+		return static_cast<int32>(TypeIndex) - 1;
+	}
+
+	/** Returns the underlying UScriptStruct, or nullptr. */
+	const UScriptStruct* GetScriptStruct() const
+	{
+		return TypeIndex ? ScriptStructTable[TypeIndex - 1]() : nullptr;
+	}
+
+	/** Returns the memory of the underlying struct value, or nullptr. */
+	const uint8* GetMemory() const
+	{
+		return TypeIndex ? StructBuffer : nullptr;
+	}
+
+	/** Returns the memory of the underlying struct value, or nullptr. */
+	uint8* GetMutableMemory()
+	{
+		return TypeIndex ? StructBuffer : nullptr;
+	}
+
+	/** Destroys the underlying struct value. */
+	void Reset()
+	{
+		if (TypeIndex)
+		{
+			DestroyTable[TypeIndex - 1](StructBuffer);
+			TypeIndex = 0;
+		}
+	}
+
+	/** Serializes in the same format as TVariadicStruct and FInstancedStruct. */
+	bool Serialize(FArchive& Ar)
+	{
+		return VariadicStruct::Private::Serialize(MakeRef(), Ar, /* Defaults */ nullptr);
+	}
+
+	/** Reports the type and the references of the value. */
+	void AddStructReferencedObjects(FReferenceCollector& Collector)
+	{
+		VariadicStruct::Private::AddStructReferencedObjects(MakeRef(), Collector);
+	}
+
+	/** Deep compares the struct values. */
+	bool operator==(const TVariadicStructOf& Other) const
+	{
+		return TypeIndex == Other.TypeIndex && (TypeIndex == 0 || GetScriptStruct()->CompareScriptStruct(StructBuffer, Other.StructBuffer, PPF_None));
+	}
+
+	bool operator!=(const TVariadicStructOf& Other) const
+	{
+		return !(*this == Other);
+	}
+
+private:
+
+	using FDefaultConstructFn = void (*)(void* Dest);
+	using FCopyConstructFn = void (*)(void* Dest, const void* Src);
+	using FCopyFn = void (*)(void* Dest, const void* Src);
+	using FMoveConstructFn = void (*)(void* Dest, void* Src);
+	using FDestroyFn = void (*)(void* Dest);
+	using FScriptStructFn = const UScriptStruct* (*)();
+
+	template<typename T>
+	static void DefaultConstruct(void* Dest)
+	{
+		if constexpr (TStructOpsTypeTraits<T>::WithZeroConstructor)
+		{
+			FMemory::Memzero(Dest, sizeof(T));
+		}
+		else if constexpr (TStructOpsTypeTraits<T>::WithNoInitConstructor)
+		{
+			new (Dest) T(ForceInit);
+		}
+		else
+		{
+			new (Dest) T();
+		}
+	}
+
+	template<typename T>
+	static void CopyConstruct(void* Dest, const void* Src)
+	{
+		new (Dest) T(*static_cast<const T*>(Src));
+	}
+
+	template<typename T>
+	static void Copy(void* Dest, const void* Src)
+	{
+		*static_cast<T*>(Dest) = *static_cast<const T*>(Src);
+	}
+
+	template<typename T>
+	static void MoveConstruct(void* Dest, void* Src)
+	{
+		new (Dest) T(MoveTemp(*static_cast<T*>(Src)));
+	}
+
+	template<typename T>
+	static void Destroy(void* Dest)
+	{
+		std::destroy_at(static_cast<T*>(Dest));
+	}
+
+	static inline constexpr FDefaultConstructFn DefaultConstructTable[] = { &DefaultConstruct<Ts>... };
+	static inline constexpr FCopyConstructFn CopyConstructTable[] = { &CopyConstruct<Ts>... };
+	static inline constexpr FCopyFn CopyTable[] = { &Copy<Ts>... };
+	static inline constexpr FMoveConstructFn MoveConstructTable[] = { &MoveConstruct<Ts>... };
+	static inline constexpr FDestroyFn DestroyTable[] = { &Destroy<Ts>... };
+	static inline constexpr FScriptStructFn ScriptStructTable[] = { &VariadicStruct::GetStaticStruct<Ts>... };
+
+	/** Bits of the listed types which are the template type or derive from it. */
+	template<typename T>
+	static consteval uint64 ChildMask()
+	{
+		uint64 Mask = 0;
+		int32 Index = 0;
+		((Mask |= std::derived_from<Ts, T> ? uint64(1) << Index : 0, ++Index), ...);
+		return Mask;
+	}
+
+	/** Returns the index of the exact UScriptStruct within the set, or INDEX_NONE. */
+	static int32 FindIndex(const UScriptStruct* InScriptStruct)
+	{
+		for (int32 Index = 0; Index < NUM_TYPES; ++Index)
+		{
+			if (InScriptStruct && ScriptStructTable[Index]() == InScriptStruct)
+			{
+				return Index;
+			}
+		}
+
+		return INDEX_NONE;
+	}
+
+	void CopyFrom(const TVariadicStructOf& InOther)
+	{
+		if (InOther.TypeIndex)
+		{
+			CopyConstructTable[InOther.TypeIndex - 1](StructBuffer, InOther.StructBuffer);
+			TypeIndex = InOther.TypeIndex;
+		}
+	}
+
+	void MoveFrom(TVariadicStructOf& InOther)
+	{
+		if (InOther.TypeIndex)
+		{
+			MoveConstructTable[InOther.TypeIndex - 1](StructBuffer, InOther.StructBuffer);
+			TypeIndex = InOther.TypeIndex;
+			InOther.Reset();
+		}
+	}
+
+	/** Returns a type-erased reference used by the shared out-of-line implementation. */
+	VariadicStruct::Private::FVariadicRef MakeRef() const
+	{
+		using FVariadicRef = VariadicStruct::Private::FVariadicRef;
+
+		static constexpr FVariadicRef::FOps Ops =
+		{
+			[](const void* Variadic) -> const UScriptStruct* { return static_cast<const TVariadicStructOf*>(Variadic)->GetScriptStruct(); },
+			[](void* Variadic) -> uint8* { return static_cast<TVariadicStructOf*>(Variadic)->GetMutableMemory(); },
+			[](void* Variadic, const UScriptStruct* InScriptStruct, const uint8* InStructMemory) { static_cast<TVariadicStructOf*>(Variadic)->InitializeAs(InScriptStruct, InStructMemory); },
+			[](void* Variadic, const UScriptStruct* InScriptStruct) { if (const int32 Index = FindIndex(InScriptStruct); Index != INDEX_NONE) { static_cast<TVariadicStructOf*>(Variadic)->TypeIndex = static_cast<uint8>(Index + 1); } },
+		};
+
+		return FVariadicRef{ const_cast<TVariadicStructOf*>(this), &Ops };
+	}
+
+	/** Inline memory buffer of the value. */
+	alignas(ALIGNMENT) uint8 StructBuffer[BUFFER_SIZE];
+
+	/** Index of the underlying type within the set plus one, 0 if empty. */
+	uint8 TypeIndex = 0;
+};
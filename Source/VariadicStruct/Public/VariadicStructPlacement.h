@@ -0,0 +1,225 @@
+// Copyright 2024 Ivan Baktenkov. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "Misc/AssertionMacros.h"
+#include "Serialization/Archive.h"
+#include "UObject/Class.h"
+#include "UObject/ObjectPtr.h"
+#include "UObject/UObjectGlobals.h"
+#include "VariadicStruct.h"
+
+/**
+ * Non-owning handle to a struct value constructed in storage provided by the caller, e.g. back to back within a ring buffer.
+ * Shares the type-erased operations with TVariadicStruct, but neither allocates nor destroys the value on its own.
+ * The storage needs to be at least GetRequiredSize() bytes aligned to GetRequiredAlignment(), and the value needs to be destroyed with Destroy().
+ * The type isn't referenced by the handle, so AddStructReferencedObjects() needs to be called if the storage outlives the GC.
+ */
+struct FVariadicStructPlacement
+{
+	FVariadicStructPlacement() = default;
+
+	/** Returns the number of bytes required to store the type. */
+	static int32 GetRequiredSize(const UScriptStruct* InScriptStruct)
+	{
+		const VariadicStruct::FTypeInfo* const TypeInfo = VariadicStruct::FindOrAddTypeInfo(InScriptStruct);
+		return TypeInfo ? TypeInfo->Size : 0;
+	}
+
+	/** Returns the alignment required to store the type. */
+	static int32 GetRequiredAlignment(const UScriptStruct* InScriptStruct)
+	{
+		const VariadicStruct::FTypeInfo* const TypeInfo = VariadicStruct::FindOrAddTypeInfo(InScriptStruct);
+		return TypeInfo ? TypeInfo->Alignment : 1;
+	}
+
+	/** Default constructs the value from UScriptStruct type within the storage and copies the value if needed. */
+	[[nodiscard]] static FVariadicStructPlacement Construct(void* InStorage, const UScriptStruct* InScriptStruct, const uint8* InStructMemory = nullptr)
+	{
+		checkf(VariadicStruct::ValidateScriptStruct(InScriptStruct), TEXT("FVariadicStructPlacement: Trying to init with unsupported UScriptStruct."));
+		return ConstructTypeInfo(InStorage, VariadicStruct::FindOrAddTypeInfo(InScriptStruct), InStructMemory);
+	}
+
+	/** Copy constructs the value of a generic struct wrapper within the storage. */
+	template<VariadicStruct::CScriptStructWrapper T>
+	[[nodiscard]] static FVariadicStructPlacement Construct(void* InStorage, const T& InStructWrapper)
+	{
+		return Construct(InStorage, InStructWrapper.GetScriptStruct(), InStructWrapper.GetMemory());
+	}
+
+	/** Emplace constructs the value from a template struct type and arguments within the storage. */
+	template<VariadicStruct::CSupportedType T, typename... TArgs>
+	[[nodiscard]] static FVariadicStructPlacement Emplace(void* InStorage, TArgs&&... InArgs)
+	{
+		checkf(IsAligned(InStorage, alignof(T)), TEXT("FVariadicStructPlacement: Misaligned storage."));
+
+		new (InStorage) T(Forward<TArgs>(InArgs)...);
+		return FVariadicStructPlacement(&VariadicStruct::GetTypeInfo<T>(), static_cast<uint8*>(InStorage));
+	}
+
+	/** Copy constructs the value within another storage. */
+	[[nodiscard]] FVariadicStructPlacement CopyTo(void* InStorage) const
+	{
+		return ConstructTypeInfo(InStorage, TypeInfo, StructMemory);
+	}
+
+	/** Copies the value of another placement of the same type into this one. */
+	void CopyFrom(const FVariadicStructPlacement& InOther)
+	{
+		checkf(GetScriptStruct() == InOther.GetScriptStruct(), TEXT("FVariadicStructPlacement: Copying different types."));
+
+		if (TypeInfo && StructMemory != InOther.StructMemory)
+		{
+			TypeInfo->Copy(*TypeInfo, StructMemory, InOther.StructMemory);
+		}
+	}
+
+	/**
+	 * Moves the value into another storage leaving this empty, the value is copied if the type is only known to the reflection.
+	 * The destination must not overlap the current storage of the value, as neither memcpy nor the copy constructor supports it.
+	 */
+	[[nodiscard]] FVariadicStructPlacement RelocateTo(void* InStorage)
+	{
+		if (!TypeInfo)
+		{
+			return FVariadicStructPlacement();
+		}
+
+		checkf(IsAligned(InStorage, TypeInfo->Alignment), TEXT("FVariadicStructPlacement: Misaligned storage."));
+		checkf(static_cast<uint8*>(InStorage) + TypeInfo->Size <= StructMemory || StructMemory + TypeInfo->Size <= static_cast<uint8*>(InStorage), TEXT("FVariadicStructPlacement: Overlapping storage."));
+
+		TypeInfo->Relocate(*TypeInfo, InStorage, StructMemory);
+		const FVariadicStructPlacement Relocated(TypeInfo, static_cast<uint8*>(InStorage));
+		*this = FVariadicStructPlacement();
+		return Relocated;
+	}
+
+	/** Destroys the value leaving the storage to the caller. */
+	void Destroy()
+	{
+		if (TypeInfo)
+		{
+			TypeInfo->DestroyValue(StructMemory);
+			*this = FVariadicStructPlacement();
+		}
+	}
+
+	/** Serializes the value only, the type needs to be known by the reader, e.g. from the message header. */
+	void Serialize(FArchive& Ar)
+	{
+		if (TypeInfo)
+		{
+			const_cast<UScriptStruct*>(TypeInfo->ScriptStruct)->SerializeItem(Ar, StructMemory, /* Defaults */ nullptr);
+		}
+	}
+
+	/** Reports the type and the references of the value. */
+	void AddStructReferencedObjects(FReferenceCollector& Collector)
+	{
+		if (TypeInfo)
+		{
+			TObjectPtr<const UScriptStruct> ScriptStruct = TypeInfo->ScriptStruct;
+			Collector.AddReferencedObject(ScriptStruct);
+
+			// The collector might null out the garbage types or replace the reinstanced ones, which needs to be reflected in the handle.
+			if (ScriptStruct != TypeInfo->ScriptStruct)
+			{
+				if (!ScriptStruct)
+				{
+					Destroy();
+					return;
+				}
+
+				TypeInfo = VariadicStruct::FindOrAddTypeInfo(ScriptStruct);
+			}
+
+			Collector.AddPropertyReferencesWithStructARO(ScriptStruct, StructMemory);
+		}
+	}
+
+	bool IsValid() const
+	{
+		return TypeInfo != nullptr;
+	}
+
+	const UScriptStruct* GetScriptStruct() const
+	{
+		return TypeInfo ? TypeInfo->ScriptStruct : nullptr;
+	}
+
+	const uint8* GetMemory() const
+	{
+		return StructMemory;
+	}
+
+	uint8* GetMutableMemory()
+	{
+		return StructMemory;
+	}
+
+	/** Returns a const pointer to the struct value, or nullptr if the type doesn't match. */
+	template<VariadicStruct::CSupportedType T>
+	[[nodiscard]] const T* GetValuePtr() const
+	{
+		return IsChildOfType<T>() ? VariadicStruct::GetTypedPtr<const T>(StructMemory) : nullptr;
+	}
+
+	/** Returns a mutable pointer to the struct value, or nullptr if the type doesn't match. */
+	template<VariadicStruct::CSupportedType T>
+	[[nodiscard]] T* GetMutableValuePtr()
+	{
+		return IsChildOfType<T>() ? VariadicStruct::GetTypedPtr<T>(StructMemory) : nullptr;
+	}
+
+	FConstStructView GetView() const
+	{
+		return FConstStructView(GetScriptStruct(), StructMemory);
+	}
+
+	FStructView GetMutableView()
+	{
+		return FStructView(GetScriptStruct(), StructMemory);
+	}
+
+private:
+
+	FVariadicStructPlacement(const VariadicStruct::FTypeInfo* InTypeInfo, uint8* InStructMemory)
+		: TypeInfo(InTypeInfo)
+		, StructMemory(InStructMemory)
+	{
+	}
+
+	template<VariadicStruct::CSupportedType T>
+	bool IsChildOfType() const
+	{
+		return TypeInfo && TypeInfo->IsChildOf(VariadicStruct::GetStaticStruct<T>(), VariadicStruct::GetStaticStructDepth<T>());
+	}
+
+	static FVariadicStructPlacement ConstructTypeInfo(void* InStorage, const VariadicStruct::FTypeInfo* InTypeInfo, const uint8* InStructMemory)
+	{
+		if (!InTypeInfo)
+		{
+			return FVariadicStructPlacement();
+		}
+
+		checkf(IsAligned(InStorage, InTypeInfo->Alignment), TEXT("FVariadicStructPlacement: Misaligned storage."));
+
+		if (InStructMemory)
+		{
+			InTypeInfo->CopyConstruct(*InTypeInfo, InStorage, InStructMemory);
+		}
+		else
+		{
+			InTypeInfo->DefaultConstruct(InStorage);
+		}
+
+		return FVariadicStructPlacement(InTypeInfo, static_cast<uint8*>(InStorage));
+	}
+
+	/** Cached operations of the type. */
+	const VariadicStruct::FTypeInfo* TypeInfo = nullptr;
+
+	/** Caller provided storage of the value. */
+	uint8* StructMemory = nullptr;
+};
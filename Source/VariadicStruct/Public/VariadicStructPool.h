@@ -0,0 +1,106 @@
+// Copyright 2024 Ivan Baktenkov. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "Templates/UniquePtr.h"
+
+#ifndef VARIADICSTRUCT_POOL_STATS
+#define VARIADICSTRUCT_POOL_STATS !UE_BUILD_SHIPPING
+#endif // VARIADICSTRUCT_POOL_STATS
+
+/**
+ * Opt-in size-class pool for the payloads which don't fit into the inline buffer.
+ * Each thread caches freed blocks per size class, the excess is returned to a shared depot to be reused by other threads,
+ * so the blocks freed on a different thread than they were allocated on eventually return to the producer.
+ *
+ * Configured with the read-only console variables, which are latched on the module startup after the ini values are applied.
+ * The pool stays disabled if it is used before that, as the blocks allocated from FMemory can't be returned to it:
+ * - VariadicStruct.Pool.Enabled - Whether the pool is used, disabled by default.
+ * - VariadicStruct.Pool.SizeClasses - Comma separated block sizes, rounded up to 16 bytes.
+ * - VariadicStruct.Pool.ThreadCacheSize - Max number of cached blocks per size class per thread.
+ *
+ * Requests exceeding the largest size class or 16-byte alignment fall back to FMemory.
+ * Use VariadicStruct.Pool.Stats console command to log the hit rate.
+ */
+namespace VariadicStruct::Pool
+{
+	/** Aggregated counters, only available with VARIADICSTRUCT_POOL_STATS. */
+	struct FStats
+	{
+		/** Requests served by the pool. */
+		uint64 NumAllocs = 0;
+
+		/** Requests served by the thread cache. */
+		uint64 NumCacheHits = 0;
+
+		/** Requests served by refilling the thread cache from the depot. */
+		uint64 NumDepotHits = 0;
+
+		/** Blocks returned to the pool. */
+		uint64 NumFrees = 0;
+
+		/** Fraction of the requests which didn't reach FMemory. */
+		double GetHitRate() const
+		{
+			return NumAllocs ? double(NumCacheHits + NumDepotHits) / double(NumAllocs) : 0.0;
+		}
+	};
+
+	/** Latches the configuration, called on the module startup. */
+	VARIADICSTRUCT_API void Initialize();
+
+	/** Whether the pool was enabled when the configuration was latched. */
+	VARIADICSTRUCT_API bool IsEnabled();
+
+	/** Allocates memory for the payload, from the pool if enabled. */
+	VARIADICSTRUCT_API void* Malloc(SIZE_T Size, uint32 Alignment);
+
+	/** Frees memory returned by Malloc(). Size and Alignment need to match the allocation. */
+	VARIADICSTRUCT_API void Free(void* Ptr, SIZE_T Size, uint32 Alignment);
+
+	/** Returns the counters aggregated over all threads. */
+	VARIADICSTRUCT_API FStats GetStats();
+
+#if WITH_DEV_AUTOMATION_TESTS
+	namespace Private
+	{
+		/**
+		 * Isolated pool with its own configuration, depot and a single thread cache, shares the code paths with the global pool.
+		 * Built from the given values instead of the console variables, only for the automation tests. Not thread-safe.
+		 */
+		class FTestPool
+		{
+		public:
+
+			FTestPool(const TCHAR* InSizeClasses, int32 InThreadCacheSize);
+			~FTestPool();
+
+			/** Latches the enabled configuration, unless the pool was already used. Returns whether it was latched. */
+			bool Initialize();
+
+			bool IsEnabled() const;
+			void* Malloc(SIZE_T Size, uint32 Alignment);
+			void Free(void* Ptr, SIZE_T Size, uint32 Alignment);
+			FStats GetStats() const;
+
+			/** Returns the block size serving the request, or 0 if it falls back to FMemory. */
+			uint32 GetBlockSize(SIZE_T Size, uint32 Alignment) const;
+
+			/** Returns the number of the blocks of the size class cached by the thread or by the depot. */
+			int32 GetNumCached(SIZE_T Size, bool bDepot) const;
+
+			/** Returns the thread cache to the depot, the later frees go straight to the depot, as after the thread exit. */
+			void ExitThread();
+
+			/** Starts with an empty thread cache, as a new thread. */
+			void StartThread();
+
+		private:
+
+			struct FImpl;
+			TUniquePtr<FImpl> Impl;
+		};
+	}
+#endif // WITH_DEV_AUTOMATION_TESTS
+}
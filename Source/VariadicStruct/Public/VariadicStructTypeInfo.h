@@ -0,0 +1,518 @@
+// Copyright 2024 Ivan Baktenkov. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "HAL/UnrealMemory.h"
+#include "Misc/EnumClassFlags.h"
+#include "Templates/IsPODType.h"
+#include "UObject/Class.h"
+
+#include <atomic>
+#include <cstddef> // offsetof()
+#include <memory> // std::destroy_at
+#include <new>	  // placement new
+#include <type_traits>
+
+namespace VariadicStruct
+{
+	/**
+	 * Whether the type can be moved with memcpy, i.e. it doesn't store pointers to itself.
+	 * Can be specialized for types which aren't trivially copyable but are safe to relocate, e.g. types with TArray members.
+	 * @Note: The trait is bound to the native descriptor, which is registered by the first GetTypeInfo<T>(), e.g. from InitializeAs<T>().
+	 *        The values initialized through the reflection before that, e.g. InitializeAs(UScriptStruct*) or loading, are moved by copying.
+	 *        Call VariadicStruct::GetTypeInfo<T>() on the module startup to make the moves independent of the call order.
+	 */
+	template<typename T>
+	struct TIsTriviallyRelocatable : std::bool_constant<std::is_trivially_copyable_v<T> || TIsPODType<T>::Value> {};
+
+	/**
+	 * Whether the default initialization copies from a cached default instance instead of running the default constructor.
+	 * Can be specialized for types with expensive default constructors, e.g. FName lookups, which need to be free of side effects.
+	 * Reflected plain old data types which aren't zero constructible use the snapshot regardless.
+	 */
+	template<typename T>
+	struct TUseDefaultSnapshot : std::false_type {};
+
+	/** Placement of the type within TVariadicStruct. */
+	enum class EStorageHint : uint8
+	{
+		/** Inline if the type fits into the buffer. */
+		Default,
+
+		/** Always on the heap, e.g. for types which fit but are moved often and aren't trivially relocatable. */
+		Heap,
+
+		/** Always inline, it's a compile-time error if the type doesn't fit into the buffer of the layout. */
+		Inline,
+	};
+
+	/**
+	 * Storage hint of the type, can be specialized per type.
+	 * Reflection only types, e.g. UDS, can use the VariadicStorage=Heap metadata in the editor. Native types ignore the metadata.
+	 */
+	template<typename T>
+	struct TStorageHint : std::integral_constant<EStorageHint, EStorageHint::Default> {};
+
+	/** Fast paths available for the type. */
+	enum class ETypeFlags : uint32
+	{
+		None = 0,
+
+		/** Can be copied with memcpy (STRUCT_IsPlainOldData). */
+		PlainOldData = 1 << 0,
+
+		/** Can be constructed with memzero (STRUCT_ZeroConstructor). */
+		ZeroConstructor = 1 << 1,
+
+		/** Doesn't need to be destroyed (STRUCT_NoDestructor). */
+		NoDestructor = 1 << 2,
+
+		/** Can be moved with memcpy, see TIsTriviallyRelocatable. */
+		TriviallyRelocatable = 1 << 3,
+
+		/** Operations are bound to the native type instead of the reflection. */
+		Native = 1 << 4,
+
+		/** Default initialized by copying a lazily built default instance, see TUseDefaultSnapshot. */
+		DefaultSnapshot = 1 << 5,
+
+		/** Stored on the heap regardless of the size, see TStorageHint. */
+		ForceHeap = 1 << 6,
+	};
+
+	ENUM_CLASS_FLAGS(ETypeFlags);
+
+	struct FTypeInfo;
+
+	namespace Private
+	{
+		/** Returns the default instance of the type with ETypeFlags::DefaultSnapshot, building it on first use. Thread-safe. */
+		VARIADICSTRUCT_API const void* GetDefaultSnapshot(const FTypeInfo& InTypeInfo);
+	}
+
+	/**
+	 * Per-type operations descriptor built once per UScriptStruct and referenced by TVariadicStruct.
+	 * Keeps everything required by the hot paths within the first 64 bytes instead of chasing UScriptStruct internals,
+	 * the ancestors for the subtype checks follow. 128 bytes in total, i.e. two cache lines on most platforms or one on 128-byte ones.
+	 * Immutable once published. A superseded descriptor stays valid for the existing values, e.g. when native operations get registered.
+	 */
+	struct alignas(PLATFORM_CACHE_LINE_SIZE) FTypeInfo
+	{
+		using FConstructFn = void (*)(const FTypeInfo& TypeInfo, void* Dest);
+		using FCopyFn = void (*)(const FTypeInfo& TypeInfo, void* Dest, const void* Src);
+		using FCopyConstructFn = void (*)(const FTypeInfo& TypeInfo, void* Dest, const void* Src);
+		using FRelocateFn = void (*)(const FTypeInfo& TypeInfo, void* Dest, void* Src);
+		using FDestroyFn = void (*)(const FTypeInfo& TypeInfo, void* Dest);
+
+		/** Reflected type. Kept alive by the values referencing it. */
+		const UScriptStruct* ScriptStruct = nullptr;
+
+		/** Size of the type, already aligned. */
+		int32 Size = 0;
+
+		/** Min alignment of the type. */
+		int32 Alignment = 0;
+
+		/** Fast paths available for the type. */
+		ETypeFlags Flags = ETypeFlags::None;
+
+		/** Stable index of the descriptor within the registry, 0 is reserved for nullptr. See FTypeIndexHandle. */
+		uint32 Index = 0;
+
+		/** Default constructs the value. */
+		FConstructFn Construct = nullptr;
+
+		/** Copies the value into an already constructed one. */
+		FCopyFn Copy = nullptr;
+
+		/** Copy constructs the value in a single pass, where possible. */
+		FCopyConstructFn CopyConstruct = nullptr;
+
+		/** Move constructs Dest from Src and destroys Src. Only native types are actually moved, otherwise it's copied. */
+		FRelocateFn Relocate = nullptr;
+
+		/** Destroys the value. */
+		FDestroyFn Destroy = nullptr;
+
+		/** Max number of the cached ancestors, deeper bases fall back to UStruct::IsChildOf(). */
+		static inline constexpr int32 MAX_ANCESTORS = 7;
+
+		/** Depth of the type within the struct hierarchy, 0 for the root structs. */
+		int32 Depth = 0;
+
+		/** Ancestors indexed by their depth up to the type itself, see IsChildOf(). */
+		const UScriptStruct* Ancestors[MAX_ANCESTORS] = {};
+
+		bool HasAnyFlags(ETypeFlags InFlags) const
+		{
+			return EnumHasAnyFlags(Flags, InFlags);
+		}
+
+		/** Default constructs the value, with memzero or by copying the default snapshot if possible. */
+		void DefaultConstruct(void* Dest) const
+		{
+			if (HasAnyFlags(ETypeFlags::ZeroConstructor))
+			{
+				FMemory::Memzero(Dest, Size);
+			}
+			else if (HasAnyFlags(ETypeFlags::DefaultSnapshot))
+			{
+				CopyConstruct(*this, Dest, Private::GetDefaultSnapshot(*this));
+			}
+			else
+			{
+				Construct(*this, Dest);
+			}
+		}
+
+		/** Destroys the value, skipping the call if the type doesn't need to be destroyed. */
+		void DestroyValue(void* Dest) const
+		{
+			if (!HasAnyFlags(ETypeFlags::NoDestructor))
+			{
+				Destroy(*this, Dest);
+			}
+		}
+
+		/** Whether the type is the same as or derives from the base type. Constant time for the bases within MAX_ANCESTORS. */
+		bool IsChildOf(const FTypeInfo& Base) const
+		{
+			return IsChildOf(Base.ScriptStruct, Base.Depth);
+		}
+
+		/**
+		 * Whether the type is the same as or derives from the base struct at the given depth, see GetStaticStructDepth<T>().
+		 * Constant time for the bases within MAX_ANCESTORS, so it doesn't need the descriptor of the base.
+		 */
+		bool IsChildOf(const UScriptStruct* Base, int32 BaseDepth) const
+		{
+			if (BaseDepth < MAX_ANCESTORS)
+			{
+				return BaseDepth <= Depth && Ancestors[BaseDepth] == Base;
+			}
+
+			return ScriptStruct->IsChildOf(Base);
+		}
+
+		/** Whether the type doesn't fit into the inline buffer or is forced to the heap. */
+		bool RequiresMemoryAllocation(int32 BufferSize, int32 BufferAlignment) const
+		{
+			return Size > BufferSize || Alignment > BufferAlignment || HasAnyFlags(ETypeFlags::ForceHeap);
+		}
+	};
+
+	static_assert(offsetof(FTypeInfo, Depth) <= 64, "FTypeInfo hot members need to fit into the first 64 bytes.");
+	static_assert(sizeof(FTypeInfo) <= 128, "FTypeInfo needs to fit into 128 bytes.");
+	static_assert(alignof(FTypeInfo) == PLATFORM_CACHE_LINE_SIZE, "FTypeInfo needs to be cache line aligned.");
+
+	/** Returns FTypeInfo of UScriptStruct building it on first use, or nullptr for nullptr. Thread-safe. */
+	VARIADICSTRUCT_API const FTypeInfo* FindOrAddTypeInfo(const UScriptStruct* InScriptStruct);
+
+	namespace Private
+	{
+		/** Descriptors are stored in chunks which are never reallocated, so the index lookup doesn't need a lock. */
+		inline constexpr uint32 TYPE_INFO_CHUNK_BITS = 10;
+		inline constexpr uint32 TYPE_INFO_CHUNK_SIZE = 1 << TYPE_INFO_CHUNK_BITS;
+		inline constexpr uint32 TYPE_INFO_MAX_CHUNKS = 1024;
+
+		/** Registry storage indexed by FTypeInfo::Index. A chunk is published before any index within it is handed out. */
+		extern VARIADICSTRUCT_API FTypeInfo* GTypeInfoChunks[TYPE_INFO_MAX_CHUNKS];
+
+		/** Publishes FTypeInfo with native operations superseding the reflection based one. Returns the persistent instance. */
+		VARIADICSTRUCT_API const FTypeInfo& RegisterNativeTypeInfo(const FTypeInfo& InTypeInfo);
+
+		/** Returns the depth of the struct within the hierarchy, 0 for the root structs. */
+		inline int32 GetStructDepth(const UStruct* InStruct)
+		{
+			int32 Depth = -1;
+
+			for (const UStruct* Struct = InStruct; Struct; Struct = Struct->GetSuperStruct())
+			{
+				++Depth;
+			}
+
+			return Depth;
+		}
+
+		/** Fills the depth and the ancestors of the type. */
+		inline void InitializeAncestors(FTypeInfo& TypeInfo)
+		{
+			int32 Depth = GetStructDepth(TypeInfo.ScriptStruct);
+			TypeInfo.Depth = Depth;
+
+			for (const UStruct* Struct = TypeInfo.ScriptStruct; Struct; Struct = Struct->GetSuperStruct(), --Depth)
+			{
+				if (Depth < FTypeInfo::MAX_ANCESTORS)
+				{
+					TypeInfo.Ancestors[Depth] = static_cast<const UScriptStruct*>(Struct);
+				}
+			}
+		}
+
+		/** Converts UScriptStruct flags into the type flags. */
+		inline ETypeFlags GetScriptStructFlags(const UScriptStruct* InScriptStruct)
+		{
+			ETypeFlags Flags = ETypeFlags::None;
+
+			if (InScriptStruct->StructFlags & STRUCT_IsPlainOldData)
+			{
+				Flags |= ETypeFlags::PlainOldData | ETypeFlags::TriviallyRelocatable;
+			}
+
+			if (InScriptStruct->StructFlags & STRUCT_ZeroConstructor)
+			{
+				Flags |= ETypeFlags::ZeroConstructor;
+			}
+
+			if (InScriptStruct->StructFlags & STRUCT_NoDestructor)
+			{
+				Flags |= ETypeFlags::NoDestructor;
+			}
+
+			return Flags;
+		}
+
+		/** Builds FTypeInfo with the operations bound to the native type. Mirrors UScriptStruct::TCppStructOps. */
+		template<typename T>
+		FTypeInfo MakeNativeTypeInfo()
+		{
+			using FTraits = TStructOpsTypeTraits<T>;
+
+			FTypeInfo TypeInfo;
+			TypeInfo.ScriptStruct = TBaseStructure<T>::Get();
+			TypeInfo.Size = sizeof(T);
+			TypeInfo.Alignment = alignof(T);
+			TypeInfo.Flags = GetScriptStructFlags(TypeInfo.ScriptStruct) | ETypeFlags::Native;
+			InitializeAncestors(TypeInfo);
+
+			if constexpr (TIsTriviallyRelocatable<T>::value)
+			{
+				TypeInfo.Flags |= ETypeFlags::TriviallyRelocatable;
+			}
+
+			if constexpr (TUseDefaultSnapshot<T>::value && !FTraits::WithZeroConstructor)
+			{
+				TypeInfo.Flags |= ETypeFlags::DefaultSnapshot;
+			}
+
+			if constexpr (TStorageHint<T>::value == EStorageHint::Heap)
+			{
+				TypeInfo.Flags |= ETypeFlags::ForceHeap;
+			}
+
+			TypeInfo.Construct = [](const FTypeInfo&, void* Dest)
+			{
+				if constexpr (FTraits::WithZeroConstructor)
+				{
+					FMemory::Memzero(Dest, sizeof(T));
+				}
+				else if constexpr (FTraits::WithNoInitConstructor)
+				{
+					new (Dest) T(ForceInit);
+				}
+				else
+				{
+					new (Dest) T();
+				}
+			};
+
+			TypeInfo.Copy = [](const FTypeInfo& InTypeInfo, void* Dest, const void* Src)
+			{
+				if constexpr (FTraits::WithCopy)
+				{
+					*static_cast<T*>(Dest) = *static_cast<const T*>(Src);
+				}
+				else
+				{
+					InTypeInfo.ScriptStruct->CopyScriptStruct(Dest, Src);
+				}
+			};
+
+			TypeInfo.CopyConstruct = [](const FTypeInfo& InTypeInfo, void* Dest, const void* Src)
+			{
+				if constexpr (TIsPODType<T>::Value)
+				{
+					FMemory::Memcpy(Dest, Src, sizeof(T));
+				}
+				else if constexpr (std::is_copy_constructible_v<T>)
+				{
+					new (Dest) T(*static_cast<const T*>(Src));
+				}
+				else
+				{
+					InTypeInfo.Construct(InTypeInfo, Dest);
+					InTypeInfo.Copy(InTypeInfo, Dest, Src);
+				}
+			};
+
+			TypeInfo.Relocate = [](const FTypeInfo& InTypeInfo, void* Dest, void* Src)
+			{
+				if constexpr (TIsTriviallyRelocatable<T>::value)
+				{
+					FMemory::Memcpy(Dest, Src, sizeof(T));
+				}
+				else if constexpr (std::is_move_constructible_v<T>)
+				{
+					// Steals the allocations of the members, e.g. TArray, and supports move-only types.
+					new (Dest) T(MoveTemp(*static_cast<T*>(Src)));
+					InTypeInfo.Destroy(InTypeInfo, Src);
+				}
+				else
+				{
+					InTypeInfo.CopyConstruct(InTypeInfo, Dest, Src);
+					InTypeInfo.Destroy(InTypeInfo, Src);
+				}
+			};
+
+			TypeInfo.Destroy = [](const FTypeInfo&, void* Dest)
+			{
+				if constexpr (!(FTraits::WithNoDestructor || TIsPODType<T>::Value))
+				{
+					std::destroy_at(static_cast<T*>(Dest));
+				}
+			};
+
+			return TypeInfo;
+		}
+	}
+
+	/** Returns FTypeInfo by its stable index, or nullptr for 0. */
+	inline const FTypeInfo* GetTypeInfoByIndex(uint32 Index)
+	{
+		return Index ? &Private::GTypeInfoChunks[Index >> Private::TYPE_INFO_CHUNK_BITS][Index & (Private::TYPE_INFO_CHUNK_SIZE - 1)] : nullptr;
+	}
+
+	/**
+	 * Type handle storing FTypeInfo pointer tagged with the storage mode in the low bit.
+	 * FTypeInfo is cache line aligned, so the low bit is always free.
+	 */
+	struct FTypePtrHandle
+	{
+		const FTypeInfo* GetTypeInfo() const
+		{
+			return reinterpret_cast<const FTypeInfo*>(Bits & ~INLINE_BIT);
+		}
+
+		void SetTypeInfo(const FTypeInfo* InTypeInfo, bool bInline)
+		{
+			Bits = reinterpret_cast<UPTRINT>(InTypeInfo) | (bInline ? INLINE_BIT : 0);
+		}
+
+		bool IsValid() const
+		{
+			return Bits != 0;
+		}
+
+		bool IsInline() const
+		{
+			return (Bits & INLINE_BIT) != 0;
+		}
+
+		/** All ones if the value is stored inline, zero otherwise. */
+		UPTRINT GetInlineMask() const
+		{
+			return UPTRINT(0) - (Bits & INLINE_BIT);
+		}
+
+	private:
+
+		static inline constexpr UPTRINT INLINE_BIT = 1;
+
+		static_assert(alignof(FTypeInfo) > INLINE_BIT, "FTypePtrHandle: FTypeInfo alignment needs to leave the low bit free.");
+
+		UPTRINT Bits = 0;
+	};
+
+	/**
+	 * Type handle storing 32-bit FTypeInfo::Index tagged with the storage mode in the low bit.
+	 * Trades an extra indirection on the type access for 4 bytes, the memory access doesn't touch the type.
+	 */
+	struct FTypeIndexHandle
+	{
+		const FTypeInfo* GetTypeInfo() const
+		{
+			return GetTypeInfoByIndex(Bits >> 1);
+		}
+
+		void SetTypeInfo(const FTypeInfo* InTypeInfo, bool bInline)
+		{
+			Bits = (InTypeInfo ? InTypeInfo->Index << 1 : 0) | (bInline ? INLINE_BIT : 0);
+		}
+
+		bool IsValid() const
+		{
+			return Bits != 0;
+		}
+
+		bool IsInline() const
+		{
+			return (Bits & INLINE_BIT) != 0;
+		}
+
+		/** All ones if the value is stored inline, zero otherwise. */
+		UPTRINT GetInlineMask() const
+		{
+			return UPTRINT(0) - (Bits & INLINE_BIT);
+		}
+
+	private:
+
+		static inline constexpr uint32 INLINE_BIT = 1;
+
+		uint32 Bits = 0;
+	};
+
+	namespace Private
+	{
+		/** Per-type cache of TBaseStructure<T>::Get(), a plain global instead of a guarded function-local static. */
+		template<typename T>
+		inline std::atomic<const UScriptStruct*> GStaticStruct = nullptr;
+
+		/** Per-type cache of the depth of TBaseStructure<T>::Get() within the struct hierarchy, INDEX_NONE until resolved. */
+		template<typename T>
+		inline std::atomic<int32> GStaticStructDepth = INDEX_NONE;
+	}
+
+	/**
+	 * Returns TBaseStructure<T>::Get() resolved on the first call, so the typed access is a single load and compare afterwards.
+	 * Thread-safe, the concurrent first calls resolve the same value.
+	 */
+	template<typename T>
+	FORCEINLINE const UScriptStruct* GetStaticStruct()
+	{
+		if (const UScriptStruct* const ScriptStruct = Private::GStaticStruct<T>.load(std::memory_order_relaxed); LIKELY(ScriptStruct))
+		{
+			return ScriptStruct;
+		}
+
+		const UScriptStruct* const ScriptStruct = TBaseStructure<T>::Get();
+		Private::GStaticStruct<T>.store(ScriptStruct, std::memory_order_relaxed);
+		return ScriptStruct;
+	}
+
+	/**
+	 * Returns the depth of GetStaticStruct<T>() within the struct hierarchy resolved on the first call, see FTypeInfo::IsChildOf().
+	 * Thread-safe, the concurrent first calls resolve the same value.
+	 */
+	template<typename T>
+	FORCEINLINE int32 GetStaticStructDepth()
+	{
+		if (const int32 Depth = Private::GStaticStructDepth<T>.load(std::memory_order_relaxed); LIKELY(Depth != INDEX_NONE))
+		{
+			return Depth;
+		}
+
+		const int32 Depth = Private::GetStructDepth(GetStaticStruct<T>());
+		Private::GStaticStructDepth<T>.store(Depth, std::memory_order_relaxed);
+		return Depth;
+	}
+
+	/** Returns FTypeInfo with the operations bound to the native type. Thread-safe. */
+	template<typename T>
+	const FTypeInfo& GetTypeInfo()
+	{
+		static const FTypeInfo& TypeInfo = Private::RegisterNativeTypeInfo(Private::MakeNativeTypeInfo<T>());
+		return TypeInfo;
+	}
+}
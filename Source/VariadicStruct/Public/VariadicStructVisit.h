@@ -0,0 +1,143 @@
+// Copyright 2024 Ivan Baktenkov. All Rights Reserved.
+
+#pragma once
+
+#include "Algo/BinarySearch.h"
+#include "Algo/Sort.h"
+#include "CoreTypes.h"
+#include "UObject/Class.h"
+#include "VariadicStruct.h"
+
+#include <type_traits>
+
+namespace VariadicStruct
+{
+	namespace Private
+	{
+		/** Overload set of the visitor callables. */
+		template<typename... TFuncs>
+		struct TOverloaded : TFuncs...
+		{
+			using TFuncs::operator()...;
+		};
+
+		/** UScriptStruct to candidate index lookup sorted by the pointer, built on first use. */
+		template<typename... Ts>
+		struct TVisitTable
+		{
+			struct FEntry
+			{
+				const UScriptStruct* ScriptStruct = nullptr;
+				int32 Index = INDEX_NONE;
+			};
+
+			FEntry Entries[sizeof...(Ts)];
+
+			TVisitTable()
+			{
+				int32 Index = 0;
+				((Entries[Index] = FEntry{ GetStaticStruct<Ts>(), Index }, ++Index), ...);
+				Algo::SortBy(Entries, &FEntry::ScriptStruct);
+			}
+
+			static const TVisitTable& Get()
+			{
+				static const TVisitTable Table;
+				return Table;
+			}
+
+			/** Returns the index of the type, or of its closest candidate ancestor, or INDEX_NONE. An exact match takes a single lookup. */
+			int32 Find(const UScriptStruct* InScriptStruct) const
+			{
+				for (const UStruct* Struct = InScriptStruct; Struct; Struct = Struct->GetSuperStruct())
+				{
+					const int32 Slot = Algo::LowerBoundBy(Entries, Struct, &FEntry::ScriptStruct);
+
+					if (Slot < static_cast<int32>(sizeof...(Ts)) && Entries[Slot].ScriptStruct == Struct)
+					{
+						return Entries[Slot].Index;
+					}
+				}
+
+				return INDEX_NONE;
+			}
+		};
+
+		template<typename TTypes, typename TVariadic, typename TOverload>
+		struct TVisitor;
+
+		template<typename... Ts, typename TVariadic, typename TOverload>
+		struct TVisitor<TypePack<Ts...>, TVariadic, TOverload>
+		{
+			static_assert(sizeof...(Ts) > 0, "Visit: Requires at least one candidate type.");
+			static_assert((CSupportedType<Ts> && ...), "Visit: Unsupported candidate type.");
+
+			static inline constexpr bool bConst = std::is_const_v<TVariadic>;
+
+			using FMemoryPtr = std::conditional_t<bConst, const uint8*, uint8*>;
+
+			template<typename T>
+			using TQualified = std::conditional_t<bConst, const T, T>;
+
+			using FResult = std::common_type_t<std::invoke_result_t<TOverload&, TQualified<Ts>&>...>;
+
+			template<typename T>
+			static FResult Dispatch(TOverload& Overload, FMemoryPtr MemoryPtr)
+			{
+				return Overload(*GetTypedPtr<TQualified<T>>(MemoryPtr));
+			}
+
+			using FDispatchFn = FResult (*)(TOverload& Overload, FMemoryPtr MemoryPtr);
+
+			/** Jump table indexed by the position of the type within the candidates. */
+			static inline constexpr FDispatchFn DispatchTable[] = { &Dispatch<Ts>... };
+
+			static FResult Visit(TVariadic& Variadic, TOverload& Overload)
+			{
+				if (const int32 Index = TVisitTable<Ts...>::Get().Find(Variadic.GetScriptStruct()); Index != INDEX_NONE)
+				{
+					if constexpr (bConst)
+					{
+						return DispatchTable[Index](Overload, Variadic.GetMemory());
+					}
+					else
+					{
+						return DispatchTable[Index](Overload, Variadic.GetMutableMemory());
+					}
+				}
+
+				// Fallback for the unknown types and empty values.
+				if constexpr (std::is_invocable_v<TOverload&>)
+				{
+					return Overload();
+				}
+				else
+				{
+					return FResult();
+				}
+			}
+		};
+	}
+
+	/**
+	 * Dispatches the value to the overload taking the matching candidate type, e.g.
+	 *
+	 * VariadicStruct::Visit<VariadicStruct::TypePack<FMyMove, FMyJump>>(Variadic,
+	 *	[](FMyMove& Move) { ... },
+	 *	[](FMyJump& Jump) { ... },
+	 *	[]() { ... }); // Optional fallback for the unknown types and empty values.
+	 *
+	 * The type is resolved with a binary search over the candidates sorted by UScriptStruct, and dispatched through a jump table.
+	 * The types deriving from a candidate go to the closest candidate ancestor, which costs a lookup per level of the hierarchy.
+	 * The value is passed as const if the variadic is const. Works with any struct wrapper, e.g. FVariadicStruct or FInstancedStruct.
+	 * Returns the common result of the overloads, or a default constructed one if there is no fallback.
+	 */
+	template<typename TTypes, typename TVariadic, typename... TFuncs>
+	decltype(auto) Visit(TVariadic& Variadic, TFuncs&&... Funcs)
+	{
+		using FOverload = Private::TOverloaded<std::decay_t<TFuncs>...>;
+
+		FOverload Overload{ Forward<TFuncs>(Funcs)... };
+		return Private::TVisitor<TTypes, TVariadic, FOverload>::Visit(Variadic, Overload);
+	}
+}
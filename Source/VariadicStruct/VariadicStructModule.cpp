@@ -1,5 +1,18 @@
 // Copyright 2024 Ivan Baktenkov. All Rights Reserved.
 
+#include "Modules/ModuleInterface.h"
 #include "Modules/ModuleManager.h"
+#include "VariadicStructPool.h"
 
-IMPLEMENT_MODULE(FDefaultModuleImpl, VariadicStruct)
+class FVariadicStructModule final : public IModuleInterface
+{
+public:
+
+	virtual void StartupModule() override
+	{
+		// The ini values of the console variables are applied by now.
+		VariadicStruct::Pool::Initialize();
+	}
+};
+
+IMPLEMENT_MODULE(FVariadicStructModule, VariadicStruct)